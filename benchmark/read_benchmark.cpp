@@ -20,6 +20,7 @@
 #endif
 
 #include <range/v3/algorithm/copy.hpp>
+#include <io/aligned_allocator.hpp>
 #include <io/buffered_read_stream.hpp>
 
 #include "black_box.hpp"
@@ -213,6 +214,41 @@ std::vector<std::uint8_t> read_modern_range_prealloc(const char* file_name)
     return output;
 }
 
+/*
+ * modern::io direct I/O tests
+ */
+
+// Read a file into a preallocated vector through a large, block-aligned buffer
+std::vector<std::uint8_t> read_modern_aligned(const char* file_name,
+                                              io::open_mode mode)
+{
+    using allocator_type = io::aligned_allocator<unsigned char>;
+    constexpr std::size_t buffer_size = 1'048'576;
+
+    auto file = io::open_file(file_name, mode);
+    auto file_size = io::seek(file, 0, io::seek_mode::end).offset_from_start();
+    io::seek(file, 0, io::seek_mode::start);
+    std::vector<std::uint8_t> output(file_size);
+
+    auto buf_file = io::buffered_read_stream<decltype(file), allocator_type>(
+            std::move(file), buffer_size, allocator_type{});
+    io::read(buf_file, io::buffer(output));
+    return output;
+}
+
+// Read through the page cache
+std::vector<std::uint8_t> read_modern_aligned_cached(const char* file_name)
+{
+    return read_modern_aligned(file_name, io::open_mode::read_only);
+}
+
+// Read bypassing the page cache
+std::vector<std::uint8_t> read_modern_aligned_direct(const char* file_name)
+{
+    return read_modern_aligned(file_name, io::open_mode::read_only |
+                                          io::open_mode::direct);
+}
+
 #ifdef _POSIX_VERSION
 /*
  * modern::io mmap tests
@@ -244,6 +280,18 @@ std::vector<std::uint8_t> read_modern_mmap_range_prealloc(const char* file_name)
     return output;
 }
 
+// Read an mmap'd file into a preallocated vector in prefetched chunks
+std::vector<std::uint8_t> read_modern_mmap_chunked_prealloc(const char* file_name)
+{
+    auto file = io::posix::mmap_file{file_name, io::open_mode::read_only};
+    std::vector<std::uint8_t> output(file.size());
+    auto out = output.data();
+    for (auto chunk : file.chunks(64 * 1024)) {
+        out += io::buffer_copy(io::buffer(out, chunk.size()), chunk);
+    }
+    return output;
+}
+
 #endif // _POSIX_VERSION
 
 } // end anonymous namespace
@@ -267,12 +315,15 @@ int main(int argc, char** argv)
             { "iostream preallocated read", read_iostream_prealloc },
             { "modern::io preallocated read", read_modern_prealloc },
             { "modern::io preallocated mmap read", read_modern_mmap_prealloc },
+            { "modern::io aligned buffered cached read", read_modern_aligned_cached },
+            { "modern::io aligned buffered direct read", read_modern_aligned_direct },
             { "iostream incremental range read", read_iostream_range },
             { "modern::io incremental range read", read_modern_range },
             { "modern::io incremental mmap range read", read_modern_mmap_range },
             { "iostream preallocated range read", read_iostream_range_prealloc },
             { "modern::io preallocated range read", read_modern_range_prealloc },
             { "modern::io preallocated mmap range read", read_modern_mmap_range_prealloc },
+            { "modern::io preallocated mmap chunked read", read_modern_mmap_chunked_prealloc },
     };
 #else // !_POSIX_VERSION
     const std::vector<test_entry> tests {
@@ -281,6 +332,8 @@ int main(int argc, char** argv)
             { "stdio preallocated read", read_stdio_prealloc },
             { "iostream preallocated read", read_iostream_prealloc },
             { "modern::io preallocated read", read_modern_prealloc },
+            { "modern::io aligned buffered cached read", read_modern_aligned_cached },
+            { "modern::io aligned buffered direct read", read_modern_aligned_direct },
             { "iostream incremental range read", read_iostream_range },
             { "modern::io incremental range read", read_modern_range },
             { "iostream preallocated range read", read_iostream_range_prealloc },
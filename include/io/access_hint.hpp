@@ -0,0 +1,37 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_ACCESS_HINT_HPP
+#define IO_ACCESS_HINT_HPP
+
+namespace io {
+
+/// Hints about how a range of a file will be accessed, which the operating
+/// system may use to tune read-ahead and caching.
+/// Hints are purely advisory and never change the result of a read or write.
+enum class access_hint {
+    /// No particular access pattern; restores the default behaviour.
+    /// This is equivalent to `POSIX_FADV_NORMAL`
+    normal,
+    /// The range will be read sequentially, so read ahead aggressively.
+    /// This is equivalent to `POSIX_FADV_SEQUENTIAL`
+    sequential,
+    /// The range will be accessed randomly, so do not read ahead.
+    /// This is equivalent to `POSIX_FADV_RANDOM`
+    random,
+    /// The range will be needed soon, so start reading it now.
+    /// This is equivalent to `POSIX_FADV_WILLNEED`
+    willneed,
+    /// The range will not be needed again, so it may be dropped from the
+    /// cache. This is equivalent to `POSIX_FADV_DONTNEED`
+    dontneed,
+    /// The range will only be accessed once.
+    /// This is equivalent to `POSIX_FADV_NOREUSE`
+    noreuse
+};
+
+} // end namespace io
+
+#endif // IO_ACCESS_HINT_HPP
@@ -0,0 +1,81 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_ALIGNED_ALLOCATOR_HPP
+#define IO_ALIGNED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace io {
+
+/// Default alignment for `aligned_allocator`, suitable for direct I/O on
+/// all common block devices
+constexpr std::size_t default_io_alignment = 4096;
+
+/// An allocator which returns storage aligned to `Alignment` bytes.
+///
+/// Using this as the allocator of a `buffered_read_stream` or
+/// `buffered_write_stream` makes the stream round its buffer capacity up to a
+/// multiple of `Alignment` and keep every transfer to the underlying stream
+/// block-aligned, as required for files opened with `open_mode::direct`.
+template <typename T, std::size_t Alignment = default_io_alignment>
+struct aligned_allocator {
+    static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+                  "Alignment must be a power of two no less than alignof(T)");
+
+    using value_type = T;
+
+    static constexpr std::size_t alignment = Alignment;
+
+    template <typename U>
+    struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+    aligned_allocator() noexcept = default;
+
+    template <typename U>
+    constexpr aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T),
+                                              std::align_val_t{Alignment}));
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept
+    {
+        ::operator delete(ptr, std::align_val_t{Alignment});
+    }
+};
+
+template <typename T, typename U, std::size_t Alignment>
+constexpr bool operator==(const aligned_allocator<T, Alignment>&,
+                          const aligned_allocator<U, Alignment>&) noexcept
+{
+    return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+constexpr bool operator!=(const aligned_allocator<T, Alignment>&,
+                          const aligned_allocator<U, Alignment>&) noexcept
+{
+    return false;
+}
+
+namespace detail {
+
+template <typename Allocator, typename = void>
+struct allocator_alignment : std::integral_constant<std::size_t, 1> {};
+
+template <typename Allocator>
+struct allocator_alignment<Allocator, std::enable_if_t<(Allocator::alignment > 0)>>
+    : std::integral_constant<std::size_t, Allocator::alignment> {};
+
+} // end namespace detail
+
+} // end namespace io
+
+#endif // IO_ALIGNED_ALLOCATOR_HPP
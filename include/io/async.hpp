@@ -0,0 +1,229 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_ASYNC_HPP
+#define IO_ASYNC_HPP
+
+#include <io/buffer.hpp>
+#include <io/traits.hpp>
+#include <io/io_std/string_view.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace io {
+
+/*
+ * Composed asynchronous operations.
+ *
+ * These are the asynchronous counterparts of io::read(), io::write() and
+ * io::read_until(). Each is built from repeated calls to the stream's
+ * async_read_some() or async_write_some(), and calls its handler exactly once,
+ * as `handler(std::error_code, std::size_t)`. Like those of the underlying
+ * stream operations, handlers are never invoked from within the initiating
+ * function.
+ */
+
+namespace detail {
+
+template <typename Buffer, typename BufSeq>
+std::vector<Buffer> make_buffer_vector(const BufSeq& buffers)
+{
+    std::vector<Buffer> vec;
+    auto first = io::buffer_sequence_begin(buffers);
+    const auto last = io::buffer_sequence_end(buffers);
+    for (; first != last; ++first) {
+        Buffer b(*first);
+        if (b.size() > 0) {
+            vec.push_back(b);
+        }
+    }
+    return vec;
+}
+
+// Drops the first `count` bytes from the front of `buffers`
+template <typename Buffer>
+void consume_buffer_vector(std::vector<Buffer>& buffers, std::size_t count)
+{
+    auto it = buffers.begin();
+    for (; it != buffers.end() && count >= it->size(); ++it) {
+        count -= it->size();
+    }
+    if (it != buffers.end()) {
+        *it += count;
+    }
+    buffers.erase(buffers.begin(), it);
+}
+
+template <typename Stream, typename Buffer, typename Handler>
+struct async_transfer_op {
+    using is_read = std::is_same<Buffer, io::mutable_buffer>;
+
+    Stream* stream;
+    std::vector<Buffer> buffers;
+    std::size_t total;
+    Handler handler;
+
+    void operator()(std::error_code ec, std::size_t bytes)
+    {
+        total += bytes;
+        consume_buffer_vector(buffers, bytes);
+
+        if (ec || buffers.empty()) {
+            handler(ec, total);
+            return;
+        }
+
+        this->start(is_read{});
+    }
+
+    void start(std::true_type /*IsRead*/)
+    {
+        auto bufs = buffers;
+        stream->async_read_some(bufs, std::move(*this));
+    }
+
+    void start(std::false_type /*IsRead*/)
+    {
+        auto bufs = buffers;
+        stream->async_write_some(bufs, std::move(*this));
+    }
+};
+
+template <typename Stream, typename DynamicBuffer, typename Handler>
+struct async_read_until_op {
+    struct state {
+        Stream& stream;
+        DynamicBuffer buffer;
+        std::string delim;
+        Handler handler;
+        // Where the next search begins: everything before this is known not
+        // to contain the start of a delimiter
+        std::size_t search_pos;
+    };
+
+    std::shared_ptr<state> state_;
+
+    void operator()(std::error_code ec, std::size_t bytes)
+    {
+        auto& st = *state_;
+        st.buffer.commit(bytes);
+
+        const auto data = st.buffer.data();
+        const char* first = static_cast<const char*>(data.data());
+        const char* last = first + data.size();
+        const char* pos = std::search(first + st.search_pos, last,
+                                      st.delim.begin(), st.delim.end());
+
+        if (pos != last) {
+            st.handler(std::error_code{},
+                       static_cast<std::size_t>(pos - first) + st.delim.size());
+            return;
+        }
+
+        // The end of the data could hold the first part of a delimiter
+        st.search_pos = data.size() >= st.delim.size()
+                ? data.size() - st.delim.size() + 1 : 0;
+
+        if (ec == stream_errc::eof) {
+            st.handler(stream_errc::not_found, 0);
+            return;
+        }
+        if (ec) {
+            st.handler(ec, 0);
+            return;
+        }
+
+        const auto space = st.buffer.max_size() - st.buffer.size();
+        if (space == 0) {
+            st.handler(stream_errc::not_found, 0);
+            return;
+        }
+
+        auto buf = st.buffer.prepare(std::min(space, net::max_single_transfer_size));
+        st.stream.async_read_some(buf, std::move(*this));
+    }
+};
+
+} // end namespace detail
+
+/// Asynchronously reads from `stream` until `buffers` are full or an error
+/// (including end of file) occurs. The buffers must remain valid until the
+/// handler is called with the total number of bytes read.
+template <typename AsyncReadStream, typename MutBufSeq, typename ReadHandler,
+          typename = std::enable_if_t<is_mutable_buffer_sequence_v<MutBufSeq>>>
+void async_read(AsyncReadStream& stream, const MutBufSeq& buffers,
+                ReadHandler&& handler)
+{
+    static_assert(is_async_read_stream_v<AsyncReadStream>,
+                  "Stream passed to async_read() is not an AsyncReadStream");
+
+    detail::async_transfer_op<AsyncReadStream, io::mutable_buffer, std::decay_t<ReadHandler>>{
+            &stream, detail::make_buffer_vector<io::mutable_buffer>(buffers),
+            0, std::forward<ReadHandler>(handler)
+    }.start(std::true_type{});
+}
+
+/// Asynchronously writes all of `buffers` to `stream`, unless an error
+/// occurs first. The buffers must remain valid until the handler is called
+/// with the total number of bytes written.
+template <typename AsyncWriteStream, typename ConstBufSeq, typename WriteHandler,
+          typename = std::enable_if_t<is_const_buffer_sequence_v<ConstBufSeq>>>
+void async_write(AsyncWriteStream& stream, const ConstBufSeq& buffers,
+                 WriteHandler&& handler)
+{
+    static_assert(is_async_write_stream_v<AsyncWriteStream>,
+                  "Stream passed to async_write() is not an AsyncWriteStream");
+
+    detail::async_transfer_op<AsyncWriteStream, io::const_buffer, std::decay_t<WriteHandler>>{
+            &stream, detail::make_buffer_vector<io::const_buffer>(buffers),
+            0, std::forward<WriteHandler>(handler)
+    }.start(std::false_type{});
+}
+
+/// Asynchronously reads from `stream` into the dynamic buffer `b` until it
+/// contains `delim`. On success the handler is passed the number of bytes up
+/// to and including the delimiter; any data beyond it is left in the buffer
+/// for a subsequent operation. If the stream ends or the buffer fills without
+/// the delimiter being found, the handler is passed `stream_errc::not_found`.
+///
+/// The dynamic buffer is moved into the operation, so its underlying storage
+/// must remain valid until the handler is called.
+template <typename AsyncReadStream, typename DynamicBuffer, typename ReadHandler,
+          typename = std::enable_if_t<is_dynamic_buffer<std::decay_t<DynamicBuffer>>::value>>
+void async_read_until(AsyncReadStream& stream, DynamicBuffer&& b,
+                      io_std::string_view delim, ReadHandler&& handler)
+{
+    static_assert(is_async_read_stream_v<AsyncReadStream>,
+                  "Stream passed to async_read_until() is not an AsyncReadStream");
+
+    using op_type = detail::async_read_until_op<AsyncReadStream,
+            std::decay_t<DynamicBuffer>, std::decay_t<ReadHandler>>;
+
+    auto st = std::make_shared<typename op_type::state>(typename op_type::state{
+            stream, std::forward<DynamicBuffer>(b),
+            std::string(delim.data(), delim.size()),
+            std::forward<ReadHandler>(handler), 0});
+
+    // The delimiter may already be in the buffer, so start with an empty read
+    // to have the first search happen in a completion handler
+    stream.async_read_some(io::mutable_buffer{}, op_type{std::move(st)});
+}
+
+template <typename AsyncReadStream, typename DynamicBuffer, typename ReadHandler,
+          typename = std::enable_if_t<is_dynamic_buffer<std::decay_t<DynamicBuffer>>::value>>
+void async_read_until(AsyncReadStream& stream, DynamicBuffer&& b, char delim,
+                      ReadHandler&& handler)
+{
+    io::async_read_until(stream, std::forward<DynamicBuffer>(b),
+                         io_std::string_view{&delim, 1},
+                         std::forward<ReadHandler>(handler));
+}
+
+} // end namespace io
+
+#endif // IO_ASYNC_HPP
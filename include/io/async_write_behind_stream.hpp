@@ -0,0 +1,276 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_ASYNC_WRITE_BEHIND_STREAM_HPP
+#define IO_ASYNC_WRITE_BEHIND_STREAM_HPP
+
+#include <io/buffer.hpp>
+#include <io/traits.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace io {
+
+/// A write stream which hands its buffers to a background thread to be
+/// written, so that the producer does not wait for the next layer.
+///
+/// Data is copied into one of `buffer_count()` buffers of `buffer_size()`
+/// bytes each. When a buffer fills up, it is queued for the I/O thread, and
+/// the producer carries on with the next free one. If every buffer is queued
+/// or being written, `write_some()` blocks until one is free, so memory use
+/// is bounded.
+///
+/// An error from the next layer is reported by the next call to
+/// `write_some()`, `flush()` or `sync()`; once one has occurred, no further
+/// data is written.
+///
+/// The stream may only be used from one thread at a time, and the next layer
+/// must not be used directly while writes are outstanding.
+template <typename Stream, typename Allocator = std::allocator<unsigned char>>
+class async_write_behind_stream {
+public:
+    using next_layer_type = std::remove_reference_t<Stream>;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+
+    static constexpr size_type default_buffer_size = 64 * 1024;
+    static constexpr size_type default_buffer_count = 2;
+
+    explicit async_write_behind_stream(Stream base,
+                                       size_type buffer_size = default_buffer_size,
+                                       size_type buffer_count = default_buffer_count,
+                                       const allocator_type& allocator = allocator_type{})
+        : base_(std::forward<Stream>(base))
+    {
+        buffer_count = std::max<size_type>(buffer_count, 1);
+        buffers_.reserve(buffer_count);
+        for (size_type i = 0; i < buffer_count; i++) {
+            buffers_.push_back(slot{buffer_vector(std::max<size_type>(buffer_size, 1),
+                                                  allocator), 0});
+            free_.push_back(i);
+        }
+        worker_ = std::thread{[this] { this->run(); }};
+    }
+
+    async_write_behind_stream(const async_write_behind_stream&) = delete;
+    async_write_behind_stream& operator=(const async_write_behind_stream&) = delete;
+
+    /// Writes out any buffered data, waiting for it to complete, and stops
+    /// the I/O thread
+    ~async_write_behind_stream()
+    {
+        std::error_code ec;
+        this->flush(ec);
+        // Swallow errors -- there's nothing else we can do
+
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        work_cond_.notify_one();
+        worker_.join();
+    }
+
+    next_layer_type& next_layer() { return base_; }
+
+    const next_layer_type& next_layer() const { return base_; }
+
+    size_type buffer_size() const noexcept { return buffers_.front().data.size(); }
+
+    size_type buffer_count() const noexcept { return buffers_.size(); }
+
+    /* SyncWriteStream implementation */
+
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb)
+    {
+        std::error_code ec;
+        const auto bytes_written = this->write_some(cb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return bytes_written;
+    }
+
+    /// Copies as much of `cb` as fits into the current buffer, first waiting
+    /// for a free buffer if there is none
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb, std::error_code& ec)
+    {
+        static_assert(is_const_buffer_sequence_v<ConstBufSeq>,
+                      "Argument passed to write_some() is not a ConstBufferSequence");
+
+        ec.clear();
+
+        if (io::buffer_size(cb) == 0) {
+            return 0;
+        }
+
+        {
+            // Don't keep accepting data which will never be written
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (error_) {
+                ec = error_;
+                return 0;
+            }
+        }
+
+        if (current_ == no_buffer || this->current().size == buffer_size()) {
+            if (!this->next_buffer(ec)) {
+                return 0;
+            }
+        }
+
+        auto& buf = this->current();
+        const auto bytes_copied = io::buffer_copy(
+                io::buffer(buf.data.data(), buf.data.size()) + buf.size, cb);
+        buf.size += bytes_copied;
+        return bytes_copied;
+    }
+
+    /// Queues any buffered data, and waits until everything written so far
+    /// has been passed to the next layer
+    void flush(std::error_code& ec)
+    {
+        ec.clear();
+
+        std::unique_lock<std::mutex> lock{mutex_};
+        this->submit(lock);
+        done_cond_.wait(lock, [this] { return queue_.empty() && !busy_; });
+        ec = error_;
+    }
+
+    void flush()
+    {
+        std::error_code ec;
+        this->flush(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Flushes the stream, and then the next layer to storage
+    template <typename S = next_layer_type,
+              typename = decltype(std::declval<S&>().sync(std::declval<std::error_code&>()))>
+    void sync(std::error_code& ec)
+    {
+        this->flush(ec);
+        if (!ec) {
+            base_.sync(ec);
+        }
+    }
+
+    template <typename S = next_layer_type,
+              typename = decltype(std::declval<S&>().sync(std::declval<std::error_code&>()))>
+    void sync()
+    {
+        std::error_code ec;
+        this->sync(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+private:
+    using buffer_vector = std::vector<unsigned char, allocator_type>;
+
+    struct slot {
+        buffer_vector data;
+        size_type size;
+    };
+
+    static constexpr size_type no_buffer = static_cast<size_type>(-1);
+
+    slot& current() { return buffers_[current_]; }
+
+    // Queues the current buffer, if it holds any data. Must be called with
+    // the lock held.
+    void submit(std::unique_lock<std::mutex>&)
+    {
+        if (current_ == no_buffer) {
+            return;
+        }
+        if (this->current().size == 0) {
+            free_.push_back(current_);
+        } else {
+            queue_.push_back(current_);
+            work_cond_.notify_one();
+        }
+        current_ = no_buffer;
+    }
+
+    // Queues the current buffer and takes a free one, waiting if necessary
+    bool next_buffer(std::error_code& ec)
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        this->submit(lock);
+        done_cond_.wait(lock, [this] { return !free_.empty() || error_; });
+        if (error_) {
+            ec = error_;
+            return false;
+        }
+        current_ = free_.back();
+        free_.pop_back();
+        this->current().size = 0;
+        return true;
+    }
+
+    // The I/O thread
+    void run()
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+
+        while (true) {
+            work_cond_.wait(lock, [this] { return !queue_.empty() || stop_; });
+            if (queue_.empty()) {
+                return;
+            }
+
+            const auto index = queue_.front();
+            queue_.pop_front();
+            busy_ = true;
+
+            if (!error_) {
+                const auto& buf = buffers_[index];
+                lock.unlock();
+                std::error_code ec;
+                io::write(base_, io::buffer(buf.data.data(), buf.size),
+                          io::transfer_all{}, ec);
+                lock.lock();
+                if (ec) {
+                    error_ = ec;
+                }
+            }
+
+            busy_ = false;
+            free_.push_back(index);
+            done_cond_.notify_all();
+        }
+    }
+
+    Stream base_;
+    std::vector<slot> buffers_;
+    size_type current_ = no_buffer;
+
+    std::mutex mutex_;
+    std::condition_variable work_cond_;
+    std::condition_variable done_cond_;
+    std::deque<size_type> queue_;
+    std::vector<size_type> free_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::error_code error_;
+
+    std::thread worker_;
+};
+
+} // end namespace io
+
+#endif // IO_ASYNC_WRITE_BEHIND_STREAM_HPP
@@ -9,25 +9,83 @@
 #ifndef MODERN_IO_BUFFERED_READ_STREAM_HPP_INCLUDED
 #define MODERN_IO_BUFFERED_READ_STREAM_HPP_INCLUDED
 
+#include <io/access_hint.hpp>
 #include <io/buffer.hpp>
 #include <io/detail/buffered_stream_storage.hpp>
-#include <io/detail/buffer_resize_guard.hpp>
 #include <io/read.hpp>
 #include <io/traits.hpp>
 #include <io/io_std/optional.hpp>
 
+#include <algorithm>
+#include <cstdint>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
 namespace io {
 
-template <typename Stream, typename Allocator = std::allocator<unsigned char>>
+namespace detail {
+
+template <typename Stream, typename = void>
+struct has_advise : std::false_type {};
+
+template <typename Stream>
+struct has_advise<Stream, void_t<
+    decltype(std::declval<Stream&>().advise(0, 0, access_hint::dontneed,
+                                            std::declval<std::error_code&>()))
+>> : std::true_type {};
+
+// Returns the preferred I/O size of the file underlying `stream`, or zero if
+// it is not known
+template <typename Stream>
+std::size_t preferred_block_size(const Stream& stream, std::true_type /*HasNativeFd*/)
+{
+#ifndef WIN32
+    struct ::stat st;
+    if (::fstat(stream.native_handle(), &st) == 0 && st.st_blksize > 0) {
+        return static_cast<std::size_t>(st.st_blksize);
+    }
+#endif
+    (void) stream;
+    return 0;
+}
+
+template <typename Stream>
+std::size_t preferred_block_size(const Stream&, std::false_type /*HasNativeFd*/)
+{
+    return 0;
+}
+
+}
+
+/// The internal buffer is a `Storage`, by default a
+/// `detail::buffered_stream_storage`. `posix::ring_buffer_storage` may be
+/// used instead to avoid moving data within the buffer, and
+/// `detail::buffered_stream_storage<Allocator, N>` to keep a buffer of up to
+/// `N` bytes inside the stream rather than allocating it.
+template <typename Stream, typename Allocator = std::allocator<unsigned char>,
+          typename Storage = detail::buffered_stream_storage<Allocator>>
 struct buffered_read_stream
 {
     using allocator_type = Allocator;
     using next_layer_type = std::remove_reference_t<Stream>;
-    using buffer_type = detail::buffered_stream_storage<allocator_type>;
+    using buffer_type = Storage;
     using size_type = typename buffer_type::size_type;
 
     static constexpr std::size_t default_buffer_size = 1024;
 
+    /// With drop-behind enabled, the amount of data which must have been read
+    /// from the next layer before it is advised to drop it from its cache
+    static constexpr std::size_t drop_behind_granularity = 1024 * 1024;
+
+    /// The default limit on the buffer size with adaptive sizing enabled
+    static constexpr std::size_t default_max_buffer_size = 1024 * 1024;
+
+    /// With adaptive sizing enabled, the number of consecutive fills which
+    /// must each fill the emptied buffer before it is grown
+    static constexpr int adaptive_growth_threshold = 2;
+
     template <typename S,
               typename = std::enable_if_t<std::is_default_constructible<S>::value>>
     buffered_read_stream() {};
@@ -82,9 +140,15 @@ struct buffered_read_stream
 
         if (storage_.empty()) {
             // if the buffer size we have been given is >= our buffer capacity,
-            // avoid the fill and just copy straight through
-            if (io::buffer_size(mb) >= storage_.capacity()) {
-                return base_.read_some(mb);
+            // avoid the fill and just copy straight through -- unless our
+            // storage is aligned for direct I/O, which the caller's may not be
+            if (buffer_type::alignment == 1 &&
+                io::buffer_size(mb) >= storage_.capacity()) {
+                // The data already consumed can no longer be sought back to
+                storage_.clear();
+                const auto bytes_read = base_.read_some(mb);
+                this->note_read(bytes_read);
+                return bytes_read;
             }
             this->fill();
         }
@@ -102,8 +166,12 @@ struct buffered_read_stream
         }
 
         if (storage_.empty()) {
-            if (io::buffer_size(mb) >= storage_.capacity()) {
-                return base_.read_some(mb, ec);
+            if (buffer_type::alignment == 1 &&
+                io::buffer_size(mb) >= storage_.capacity()) {
+                storage_.clear();
+                const auto bytes_read = base_.read_some(mb, ec);
+                this->note_read(bytes_read);
+                return bytes_read;
             }
             if (this->fill(ec) == 0) {
                 return 0;
@@ -190,50 +258,219 @@ struct buffered_read_stream
         return base_.write_some(cb, ec);
     }
 
+    /// Reads more data from the next layer into the internal buffer, after any
+    /// data already buffered.
+    /// @returns The number of bytes read, which is zero if the buffer is full
     size_type fill()
     {
-        detail::buffer_resize_guard<buffer_type> resize_guard(storage_);
-        auto prev_size = storage_.size();
-        storage_.resize(storage_.capacity()); // ?
-        storage_.resize(prev_size + base_.read_some(io::buffer(
-                storage_.data() + prev_size,
-                storage_.size() + prev_size
-        )));
-        resize_guard.commit();
-        return storage_.size() - prev_size;
+        const bool was_empty = storage_.empty();
+        const auto space = storage_.prepare();
+        const auto bytes_read = base_.read_some(space);
+        storage_.commit(bytes_read);
+        this->note_read(bytes_read);
+        this->adapt(was_empty, space.size(), bytes_read);
+        return bytes_read;
     }
 
     size_type fill(std::error_code& ec)
     {
-        detail::buffer_resize_guard<buffer_type> resize_guard(storage_);
-        auto prev_size = storage_.size();
-        storage_.resize(storage_.capacity()); // ?
-        storage_.resize(prev_size +
-                base_.read_some(io::buffer(
-                storage_.data() + prev_size,
-                storage_.size() + prev_size),
-                                ec
-        ));
-        resize_guard.commit();
-        return storage_.size() - prev_size;
+        const bool was_empty = storage_.empty();
+        const auto space = storage_.prepare();
+        const auto bytes_read = base_.read_some(space, ec);
+        storage_.commit(bytes_read);
+        this->note_read(bytes_read);
+        this->adapt(was_empty, space.size(), bytes_read);
+        return bytes_read;
     }
 
+    /* BufferedReadStream implementation */
+
+    /// Returns the data held in the internal buffer. The buffer is invalidated
+    /// by any other operation on the stream.
+    io::const_buffer data() const noexcept
+    {
+        return io::buffer(storage_.data().data(), storage_.size());
+    }
+
+    /// Discards the first `count` bytes of the buffered data, or all of it if
+    /// there are fewer than `count` bytes
+    void consume(size_type count) noexcept
+    {
+        storage_.consume(std::min(count, storage_.size()));
+    }
+
+    /// Returns the current capacity of the internal buffer
+    size_type buffer_capacity() const noexcept { return storage_.capacity(); }
+
+    /// Enables adaptive sizing of the internal buffer. The buffer starts at
+    /// its current capacity, and doubles each time the stream is seen to be
+    /// read faster than it can be filled -- that is, when successive fills
+    /// each find the buffer empty and fill it completely -- up to a maximum
+    /// of `max_buffer_size` bytes. A stream which is read in short bursts, or
+    /// from a source which delivers data in small pieces, keeps a small
+    /// buffer.
+    ///
+    /// If `use_block_size` is true and the next layer is backed by a file
+    /// descriptor, growth is in multiples of the file's preferred I/O size,
+    /// as reported by `fstat()`.
+    ///
+    /// A maximum size of zero disables adaptive sizing.
+    void set_adaptive(size_type max_buffer_size = default_max_buffer_size,
+                      bool use_block_size = true)
+    {
+        max_buffer_size_ = max_buffer_size;
+        full_fills_ = 0;
+        block_size_ = use_block_size
+                ? detail::preferred_block_size(base_, detail::has_native_fd<next_layer_type>{})
+                : 0;
+    }
+
+    bool adaptive() const noexcept { return max_buffer_size_ > 0; }
+
     io::position_type<next_layer_type>
     seek(io::offset_type<next_layer_type> distance, io::seek_mode from)
     {
-        storage_.clear();
-        return base_.seek(distance, from);
+        std::error_code ec;
+        const auto pos = this->seek(distance, from, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return pos;
     }
 
+    /// Moves the read position. A seek which lands within the buffered data,
+    /// or within the data consumed from the buffer since it was last filled,
+    /// just moves the position within the buffer; anything else discards the
+    /// buffer and seeks the next layer.
     io::position_type<next_layer_type>
     seek(io::offset_type<next_layer_type> distance, io::seek_mode from,
          std::error_code& ec)
     {
+        using position_t = io::position_type<next_layer_type>;
+
+        ec.clear();
+
+        if (!position_known_ && from != io::seek_mode::end) {
+            // Ask the next layer where it is, without disturbing the buffer
+            const auto base_pos = base_.seek(0, io::seek_mode::current, ec);
+            if (ec) {
+                return base_pos;
+            }
+            read_end_ = drop_start_ = base_pos.offset_from_start();
+            position_known_ = true;
+        }
+
+        if (position_known_ && from != io::seek_mode::end) {
+            const std::int64_t pos = read_end_ - static_cast<std::int64_t>(storage_.size());
+            const std::int64_t target = (from == io::seek_mode::start)
+                    ? distance : pos + distance;
+            const std::int64_t window_start =
+                    pos - static_cast<std::int64_t>(storage_.rewindable());
+
+            if (target >= window_start && target <= read_end_) {
+                if (target >= pos) {
+                    storage_.consume(static_cast<size_type>(target - pos));
+                } else {
+                    storage_.rewind(static_cast<size_type>(pos - target));
+                }
+                return position_t{static_cast<io::offset_type<next_layer_type>>(target)};
+            }
+        }
+
+        // The next layer is ahead of us by the amount buffered
+        if (from == io::seek_mode::current) {
+            distance -= static_cast<io::offset_type<next_layer_type>>(storage_.size());
+        }
         storage_.clear();
-        return base_.seek(distance, from, ec);
+        const auto pos = base_.seek(distance, from, ec);
+        if (ec) {
+            position_known_ = false;
+            return pos;
+        }
+        read_end_ = drop_start_ = pos.offset_from_start();
+        position_known_ = true;
+        return pos;
     }
 
+    io::position_type<next_layer_type> get_position()
+    {
+        return this->seek(0, io::seek_mode::current);
+    }
+
+    /// Returns the position of the next byte to be read, taking account of
+    /// the data which is buffered. Only the first call, or the first after an
+    /// error, needs to ask the next layer for its position.
+    io::position_type<next_layer_type> get_position(std::error_code& ec)
+    {
+        return this->seek(0, io::seek_mode::current, ec);
+    }
+
+    /// Enables or disables drop-behind. With drop-behind enabled, data which
+    /// has been read from the next layer is periodically dropped from the
+    /// operating system's page cache, so that a long sequential scan does not
+    /// evict other, more useful, cached data.
+    template <typename S = next_layer_type,
+              typename = std::enable_if_t<detail::has_advise<S>::value &&
+                                          io::is_seekable_stream_v<S>>>
+    void set_drop_behind(bool enable)
+    {
+        drop_behind_ = enable;
+        if (enable) {
+            read_end_ = drop_start_ =
+                    base_.seek(0, io::seek_mode::current).offset_from_start();
+            position_known_ = true;
+        }
+    }
+
+    bool drop_behind() const noexcept { return drop_behind_; }
+
 private:
+    void note_read(size_type bytes)
+    {
+        read_end_ += bytes;
+        if (!drop_behind_) {
+            return;
+        }
+
+        if (static_cast<std::uint64_t>(read_end_ - drop_start_) >= drop_behind_granularity) {
+            this->drop_read_data(detail::has_advise<next_layer_type>{});
+        }
+    }
+
+    void drop_read_data(std::true_type /*HasAdvise*/)
+    {
+        // Failure to drop is harmless, so ignore errors
+        std::error_code ec;
+        base_.advise(drop_start_, read_end_ - drop_start_,
+                     access_hint::dontneed, ec);
+        drop_start_ = read_end_;
+    }
+
+    void drop_read_data(std::false_type /*HasAdvise*/) {}
+
+    void adapt(bool was_empty, size_type space, size_type bytes_read)
+    {
+        if (storage_.capacity() >= max_buffer_size_) {
+            return;
+        }
+
+        if (!was_empty || bytes_read < space) {
+            full_fills_ = 0;
+            return;
+        }
+
+        if (++full_fills_ < adaptive_growth_threshold) {
+            return;
+        }
+        full_fills_ = 0;
+
+        size_type new_capacity = std::max(2 * storage_.capacity(), block_size_);
+        if (block_size_ > 0) {
+            new_capacity = (new_capacity + block_size_ - 1) / block_size_ * block_size_;
+        }
+        storage_.grow(std::min(new_capacity, max_buffer_size_));
+    }
+
     template <typename MutBufSeq>
     size_type copy(const MutBufSeq& mb)
     {
@@ -250,6 +487,14 @@ private:
 
     Stream base_{};
     buffer_type storage_{default_buffer_size};
+    bool drop_behind_ = false;
+    std::int64_t drop_start_ = 0;
+    // The position of the next layer, if position_known_ is set
+    std::int64_t read_end_ = 0;
+    bool position_known_ = false;
+    size_type max_buffer_size_ = 0;
+    size_type block_size_ = 0;
+    int full_fills_ = 0;
 };
 
 
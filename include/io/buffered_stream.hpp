@@ -86,6 +86,16 @@ struct buffered_stream {
         return read_stream_.peek(mb, ec);
     }
 
+    io::const_buffer data() const noexcept
+    {
+        return read_stream_.data();
+    }
+
+    void consume(std::size_t count) noexcept
+    {
+        read_stream_.consume(count);
+    }
+
     std::size_t fill()
     {
         return read_stream_.fill();
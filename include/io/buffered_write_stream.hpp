@@ -15,13 +15,53 @@
 #include <io/read.hpp>
 #include <io/traits.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
 namespace io {
 
-template <typename Stream, typename Allocator = std::allocator<unsigned char>>
+namespace detail {
+
+template <typename Stream, typename = void>
+struct has_allocate : std::false_type {};
+
+template <typename Stream>
+struct has_allocate<Stream, void_t<
+    decltype(std::declval<Stream&>().allocate(0, 0, std::declval<std::error_code&>())),
+    decltype(std::declval<Stream&>().resize(0, std::declval<std::error_code&>()))
+>> : std::true_type {};
+
+template <typename Stream, typename = void>
+struct has_is_append : std::false_type {};
+
+template <typename Stream>
+struct has_is_append<Stream, void_t<
+    decltype(bool(std::declval<const Stream&>().is_append()))
+>> : std::true_type {};
+
+template <typename Stream, typename = void>
+struct has_close : std::false_type {};
+
+template <typename Stream>
+struct has_close<Stream, void_t<
+    decltype(std::declval<Stream&>().close(std::declval<std::error_code&>()))
+>> : std::true_type {};
+
+} // end namespace detail
+
+/// The internal buffer is a `Storage`, by default a
+/// `detail::buffered_stream_storage`. `posix::ring_buffer_storage` may be
+/// used instead to avoid moving data within the buffer, and
+/// `detail::buffered_stream_storage<Allocator, N>` to keep a buffer of up to
+/// `N` bytes inside the stream rather than allocating it.
+template <typename Stream, typename Allocator = std::allocator<unsigned char>,
+          typename Storage = detail::buffered_stream_storage<Allocator>>
 struct buffered_write_stream {
     using allocator_type = Allocator;
     using next_layer_type = std::remove_reference_t<Stream>;
-    using buffer_type = detail::buffered_stream_storage<allocator_type>;
+    using buffer_type = Storage;
     using size_type = typename buffer_type::size_type;
 
     static constexpr std::size_t default_buffer_size = 1024;
@@ -55,6 +95,7 @@ struct buffered_write_stream {
     {
         std::error_code ec;
         this->flush(ec);
+        this->trim(ec);
         // Swallow errors -- there's nothing else we can do
     }
 
@@ -87,31 +128,44 @@ struct buffered_write_stream {
     template <typename ConstBufSeq>
     std::size_t write_some(const ConstBufSeq& cb)
     {
-        if (io::buffer_size(cb) == 0) {
-            return 0;
-        }
-
-        if (storage_.size() == storage_.capacity()) {
-            this->flush();
+        std::error_code ec;
+        const auto bytes_written = this->write_some(cb, ec);
+        if (ec) {
+            throw std::system_error{ec};
         }
-
-        return this->copy(cb);
+        return bytes_written;
     }
 
+    /// Buffers `cb` if it fits in the remaining space. Otherwise, the
+    /// buffered data and `cb` are passed together to a single `write_some()`
+    /// call on the next layer -- a single `writev()` for a file -- or, if
+    /// nothing is buffered, `cb` is written straight through.
+    /// @returns The number of bytes of `cb` which were written or buffered
     template <typename ConstBufSeq>
     std::size_t write_some(const ConstBufSeq& cb, std::error_code& ec)
     {
         ec.clear();
 
-        if (io::buffer_size(cb) == 0) {
+        const auto bytes_avail = io::buffer_size(cb);
+        if (bytes_avail == 0) {
             return 0;
         }
 
-        if (storage_.size() == storage_.capacity() && !this->flush(ec)) {
-            return 0;
+        if (storage_.size() + bytes_avail <= storage_.capacity()) {
+            return this->copy(cb);
         }
 
-        return this->copy(cb);
+        // Aligned storage is for direct I/O, which the caller's buffers may
+        // not be suitable for, so everything must go through the buffer
+        if (buffer_type::alignment != 1) {
+            if (storage_.size() == storage_.capacity() && !this->flush(ec)) {
+                return 0;
+            }
+            return this->copy(cb);
+        }
+
+        return this->write_through(cb, ec,
+                std::is_convertible<ConstBufSeq, io::const_buffer>{});
     }
 
     std::size_t flush()
@@ -119,6 +173,7 @@ struct buffered_write_stream {
         const auto bytes_written = io::write(base_, io::buffer(
                 storage_.data(), storage_.size()));
         storage_.consume(bytes_written);
+        this->note_written(bytes_written);
         return bytes_written;
     }
 
@@ -127,6 +182,7 @@ struct buffered_write_stream {
         const auto bytes_written = io::write(base_, io::buffer(
                 storage_.data(), storage_.size()), io::transfer_all{}, ec);
         storage_.consume(bytes_written);
+        this->note_written(bytes_written);
         return bytes_written;
     }
 
@@ -134,7 +190,9 @@ struct buffered_write_stream {
     seek(io::offset_type<next_layer_type> distance, io::seek_mode from)
     {
         flush();
-        return base_.seek(distance, from);
+        const auto pos = base_.seek(distance, from);
+        this->note_seek(pos);
+        return pos;
     }
 
     io::position_type<next_layer_type>
@@ -146,10 +204,192 @@ struct buffered_write_stream {
         if (ec) {
             return 0;
         }
-        return base_.seek(distance, from, ec);
+        const auto pos = base_.seek(distance, from, ec);
+        if (!ec) {
+            this->note_seek(pos);
+        }
+        return pos;
+    }
+
+    /// Tells the stream that about `expected_size` bytes are going to be
+    /// written from the current position, so that the next layer can allocate
+    /// the space up front as a single extent. If fewer bytes are written,
+    /// the unused space is trimmed off again by `close()` or on destruction;
+    /// data which was in the file beforehand is never trimmed. Streams in
+    /// append mode would write after the allocated space rather than into
+    /// it, so nothing is allocated for them.
+    template <typename S = next_layer_type,
+              typename = std::enable_if_t<detail::has_allocate<S>::value &&
+                                          io::is_seekable_stream_v<S>>>
+    void preallocate(std::uint64_t expected_size, std::error_code& ec)
+    {
+        ec.clear();
+
+        this->flush(ec);
+        if (ec || this->is_append(detail::has_is_append<S>{})) {
+            return;
+        }
+
+        const auto pos = base_.seek(0, io::seek_mode::current, ec);
+        if (ec) {
+            return;
+        }
+        const auto end = base_.seek(0, io::seek_mode::end, ec);
+        if (ec) {
+            return;
+        }
+        base_.seek(pos.offset_from_start(), io::seek_mode::start, ec);
+        if (ec) {
+            return;
+        }
+
+        base_.allocate(pos.offset_from_start(),
+                       static_cast<io::offset_type<S>>(expected_size), ec);
+        if (ec) {
+            return;
+        }
+
+        preallocated_ = true;
+        write_pos_ = high_water_ = pos.offset_from_start();
+        orig_size_ = end.offset_from_start();
+    }
+
+    template <typename S = next_layer_type,
+              typename = std::enable_if_t<detail::has_allocate<S>::value &&
+                                          io::is_seekable_stream_v<S>>>
+    void preallocate(std::uint64_t expected_size)
+    {
+        std::error_code ec;
+        this->preallocate(expected_size, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Flushes the buffer, trims any unused preallocated space and closes the
+    /// next layer
+    template <typename S = next_layer_type,
+              typename = std::enable_if_t<detail::has_close<S>::value>>
+    void close(std::error_code& ec)
+    {
+        this->flush(ec);
+        if (ec) {
+            return;
+        }
+        this->trim(ec);
+        if (ec) {
+            return;
+        }
+        base_.close(ec);
+    }
+
+    template <typename S = next_layer_type,
+              typename = std::enable_if_t<detail::has_close<S>::value>>
+    void close()
+    {
+        std::error_code ec;
+        this->close(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
     }
 
 private:
+    void note_written(size_type bytes) noexcept
+    {
+        if (preallocated_) {
+            write_pos_ += static_cast<std::int64_t>(bytes);
+            high_water_ = std::max(high_water_, write_pos_);
+        }
+    }
+
+    template <typename Position>
+    void note_seek(const Position& pos) noexcept
+    {
+        if (preallocated_) {
+            write_pos_ = pos.offset_from_start();
+        }
+    }
+
+    bool is_append(std::true_type /*HasIsAppend*/) const noexcept
+    {
+        return base_.is_append();
+    }
+
+    bool is_append(std::false_type /*HasIsAppend*/) const noexcept
+    {
+        return false;
+    }
+
+    void trim(std::error_code& ec)
+    {
+        ec.clear();
+        if (preallocated_) {
+            this->trim(detail::has_allocate<next_layer_type>{}, ec);
+        }
+    }
+
+    void trim(std::true_type /*HasAllocate*/, std::error_code& ec)
+    {
+        base_.resize(std::max(high_water_, orig_size_), ec);
+        if (!ec) {
+            preallocated_ = false;
+        }
+    }
+
+    void trim(std::false_type /*HasAllocate*/, std::error_code&) {}
+
+    template <typename ConstBufSeq>
+    std::size_t write_through(const ConstBufSeq& cb, std::error_code& ec,
+                              std::true_type /*IsSingleBuffer*/)
+    {
+        if (storage_.empty()) {
+            const auto bytes_written = base_.write_some(cb, ec);
+            this->note_written(bytes_written);
+            return bytes_written;
+        }
+
+        const std::array<io::const_buffer, 2> bufs{{
+            io::buffer(storage_.data(), storage_.size()), io::const_buffer(cb)
+        }};
+        return this->gather_write(bufs, cb, ec);
+    }
+
+    template <typename ConstBufSeq>
+    std::size_t write_through(const ConstBufSeq& cb, std::error_code& ec,
+                              std::false_type /*IsSingleBuffer*/)
+    {
+        if (storage_.empty()) {
+            const auto bytes_written = base_.write_some(cb, ec);
+            this->note_written(bytes_written);
+            return bytes_written;
+        }
+
+        std::vector<io::const_buffer> bufs;
+        bufs.emplace_back(io::buffer(storage_.data(), storage_.size()));
+        bufs.insert(bufs.end(), io::buffer_sequence_begin(cb),
+                    io::buffer_sequence_end(cb));
+        return this->gather_write(bufs, cb, ec);
+    }
+
+    // Writes the buffered data followed by the caller's, returning how much
+    // of the caller's data was written. If the write did not get past the
+    // buffered data, as much of the caller's data as fits is buffered in the
+    // space it freed instead, so that the call still makes progress.
+    template <typename GatherBufs, typename ConstBufSeq>
+    std::size_t gather_write(const GatherBufs& bufs, const ConstBufSeq& cb,
+                             std::error_code& ec)
+    {
+        const auto bytes_written = base_.write_some(bufs, ec);
+        this->note_written(bytes_written);
+        const auto from_storage = std::min<std::size_t>(bytes_written, storage_.size());
+        storage_.consume(from_storage);
+        if (bytes_written > from_storage || ec) {
+            return bytes_written - from_storage;
+        }
+        return this->copy(cb);
+    }
+
     template <typename ConstBufSeq>
     std::size_t copy(const ConstBufSeq& cb)
     {
@@ -163,6 +403,10 @@ private:
 
     Stream base_;
     buffer_type storage_{default_buffer_size};
+    bool preallocated_ = false;
+    std::int64_t write_pos_ = 0;
+    std::int64_t high_water_ = 0;
+    std::int64_t orig_size_ = 0;
 };
 
 }
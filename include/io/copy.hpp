@@ -1,4 +1,3 @@
-
 // Copyright (c) 2016 Tristan Brindle (tcbrindle at gmail dot com)
 // Distributed under the Boost Software License, Version 1.0. (See accompanying
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
@@ -11,13 +10,19 @@
 
 #include <cassert>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace io {
 
-/// Copies the whole of one stream into another
-template <typename ReadStream, typename WriteStream,
-          typename = std::enable_if_t<is_sync_read_stream_v<ReadStream> &&
-                                      is_sync_write_stream_v<WriteStream>>>
-std::size_t copy(ReadStream&& src, WriteStream&& dest, std::error_code& ec)
+namespace detail {
+
+template <typename ReadStream, typename WriteStream>
+std::size_t buffered_copy(ReadStream& src, WriteStream& dest, std::error_code& ec)
 {
     std::size_t total_bytes_copied = 0;
     std::array<std::uint8_t, 1024> buf;
@@ -49,6 +54,129 @@ std::size_t copy(ReadStream&& src, WriteStream&& dest, std::error_code& ec)
     return total_bytes_copied;
 }
 
+#ifdef __linux__
+
+// Errors with which the kernel tells us that it cannot perform a particular
+// kind of in-kernel copy between these two descriptors
+inline bool is_kernel_copy_refusal(int error) noexcept
+{
+    return error == EINVAL || error == EXDEV || error == ENOSYS ||
+           error == EOPNOTSUPP || error == EBADF ||
+           error == EAGAIN;
+}
+
+// Repeatedly calls transfer(chunk_size), which moves data between the file
+// descriptors without it passing through user space, until end of file.
+// Returns true when the copy is complete (or failed with `ec` set), or false
+// if the kernel refused the copy, in which case the caller should carry on
+// in user space.
+template <typename Transfer>
+bool kernel_transfer_loop(Transfer transfer, std::size_t& total_bytes_copied,
+                          std::error_code& ec) noexcept
+{
+    constexpr std::size_t chunk_size = 1u << 30;
+
+    while (true) {
+        errno = 0;
+        const ::ssize_t bytes = transfer(chunk_size);
+
+        if (bytes > 0) {
+            total_bytes_copied += static_cast<std::size_t>(bytes);
+        } else if (bytes == 0) {
+            return true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (is_kernel_copy_refusal(errno)) {
+            return false;
+        } else {
+            ec.assign(errno, std::system_category());
+            return true;
+        }
+    }
+}
+
+// Copies everything from in_fd's current position to out_fd inside the
+// kernel, using copy_file_range(), sendfile() or splice() as appropriate.
+// Returns false if none of these could be used; some data may already have
+// been copied, in which case both file positions will have been advanced.
+inline bool kernel_copy(int in_fd, int out_fd, std::size_t& total_bytes_copied,
+                        std::error_code& ec) noexcept
+{
+    ec.clear();
+
+    struct ::stat in_stat{};
+    struct ::stat out_stat{};
+    if (::fstat(in_fd, &in_stat) != 0 || ::fstat(out_fd, &out_stat) != 0) {
+        return false;
+    }
+
+    if (S_ISFIFO(in_stat.st_mode) || S_ISFIFO(out_stat.st_mode)) {
+        return kernel_transfer_loop([=] (std::size_t n) {
+            return ::splice(in_fd, nullptr, out_fd, nullptr, n, SPLICE_F_MOVE);
+        }, total_bytes_copied, ec);
+    }
+
+    if (!S_ISREG(in_stat.st_mode)) {
+        return false;
+    }
+
+    if (S_ISREG(out_stat.st_mode) &&
+        kernel_transfer_loop([=] (std::size_t n) {
+            return ::copy_file_range(in_fd, nullptr, out_fd, nullptr, n, 0);
+        }, total_bytes_copied, ec)) {
+        return true;
+    }
+
+    return kernel_transfer_loop([=] (std::size_t n) {
+        return ::sendfile(out_fd, in_fd, nullptr, n);
+    }, total_bytes_copied, ec);
+}
+
+#endif // __linux__
+
+template <typename ReadStream, typename WriteStream>
+std::size_t copy_impl(ReadStream& src, WriteStream& dest, std::error_code& ec,
+                      std::false_type /*HasNativeFds*/)
+{
+    return detail::buffered_copy(src, dest, ec);
+}
+
+template <typename ReadStream, typename WriteStream>
+std::size_t copy_impl(ReadStream& src, WriteStream& dest, std::error_code& ec,
+                      std::true_type /*HasNativeFds*/)
+{
+#ifdef __linux__
+    std::size_t total_bytes_copied = 0;
+    if (detail::kernel_copy(src.native_handle(), dest.native_handle(),
+                            total_bytes_copied, ec)) {
+        return total_bytes_copied;
+    }
+    // The kernel refused, so finish the job ourselves
+    return total_bytes_copied + detail::buffered_copy(src, dest, ec);
+#else
+    return detail::buffered_copy(src, dest, ec);
+#endif
+}
+
+} // end namespace detail
+
+/// Copies the whole of one stream into another
+///
+/// If both streams are backed by file descriptors (such as `posix::file` or
+/// `posix::descriptor_stream`), the data is copied inside the kernel where
+/// possible, falling back to copying through a user-space buffer otherwise.
+template <typename ReadStream, typename WriteStream,
+          typename = std::enable_if_t<is_sync_read_stream_v<ReadStream> &&
+                                      is_sync_write_stream_v<WriteStream>>>
+std::size_t copy(ReadStream&& src, WriteStream&& dest, std::error_code& ec)
+{
+    using has_native_fds = std::integral_constant<bool,
+            detail::has_native_fd<std::decay_t<ReadStream>>::value &&
+            detail::has_native_fd<std::decay_t<WriteStream>>::value>;
+
+    return detail::copy_impl(src, dest, ec, has_native_fds{});
+}
+
 /// @overload
 template <typename ReadStream, typename WriteStream,
           typename = std::enable_if_t<is_sync_read_stream_v<ReadStream> &&
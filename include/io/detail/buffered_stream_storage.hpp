@@ -8,40 +8,80 @@
 #ifndef MODERN_IO_DETAIL_BUFFERED_STREAM_STORAGE_HPP_INCLUDED
 #define MODERN_IO_DETAIL_BUFFERED_STREAM_STORAGE_HPP_INCLUDED
 
+#include <io/aligned_allocator.hpp>
 #include <io/buffer.hpp>
+
+#include <algorithm>
 #include <vector>
 
 namespace io {
 namespace detail {
 
-template <typename Allocator = std::allocator<unsigned char>>
-struct buffered_stream_storage {
+// The bytes which buffered_stream_storage keeps inside itself. They are left
+// uninitialised, and take up no space when there are none.
+template <std::size_t N, std::size_t Alignment>
+struct inline_storage_bytes {
+    unsigned char* inline_data() { return bytes_; }
+    const unsigned char* inline_data() const { return bytes_; }
+
+private:
+    alignas(Alignment) unsigned char bytes_[N];
+};
+
+template <std::size_t Alignment>
+struct inline_storage_bytes<0, Alignment> {
+    unsigned char* inline_data() { return nullptr; }
+    const unsigned char* inline_data() const { return nullptr; }
+};
+
+/// With a non-zero `InlineCapacity`, the first `InlineCapacity` bytes of
+/// storage are held inside the object itself, so that a small buffer costs
+/// no allocation. The capacity is still the one asked for, and the storage
+/// only moves to the heap if it is asked for, or later grown to, a capacity
+/// larger than `InlineCapacity`.
+template <typename Allocator = std::allocator<unsigned char>,
+          std::size_t InlineCapacity = 0>
+struct buffered_stream_storage
+        : private inline_storage_bytes<InlineCapacity,
+                                       allocator_alignment<Allocator>::value> {
     using byte_type = unsigned char;
     using size_type = std::size_t;
     using allocator_type = Allocator;
 
+    /// Alignment of the start of the storage, and granularity of its capacity.
+    /// This is greater than one for storage intended for direct I/O.
+    static constexpr size_type alignment = allocator_alignment<Allocator>::value;
+
+    static constexpr size_type inline_capacity = InlineCapacity;
+
+    static_assert(inline_capacity % alignment == 0,
+                  "Inline capacity must be a multiple of the allocator's alignment");
+
     explicit buffered_stream_storage(size_type max_size)
-            : vec_(max_size)
+            : inline_size_(inline_size(max_size)),
+              vec_(heap_size(max_size))
     {}
 
     buffered_stream_storage(size_type max_size, const allocator_type& allocator)
-            : vec_(max_size, allocator)
+            : inline_size_(inline_size(max_size)),
+              vec_(heap_size(max_size), allocator)
     {}
 
     void clear()
     {
         begin_ = 0;
         end_ = 0;
+        history_ = 0;
     }
 
     mutable_buffer data()
     {
-        return io::buffer(vec_) + begin_;
+        return io::buffer(this->bytes(), capacity()) + begin_;
     }
 
     const_buffer data() const
     {
-        return io::buffer(vec_) + begin_;
+        return io::buffer(this->bytes(), capacity()) + begin_;
     }
 
     bool empty() const
@@ -60,31 +100,131 @@ struct buffered_stream_storage {
         if (begin_ + length <= capacity()) {
             end_ = begin_ + length;
         } else {
-            std::move(vec_.begin() + begin_, vec_.begin() + size(), vec_.begin());
+            std::move(this->bytes() + begin_, this->bytes() + end_, this->bytes());
             end_ = length;
             begin_ = 0;
+            history_ = 0;
         }
     }
 
     size_type capacity() const
     {
-        return vec_.size();
+        return this->on_heap() ? vec_.size() : inline_size_;
     }
 
-    void consume(size_type count)
+    /// Increases the capacity to at least `new_capacity`, keeping any stored
+    /// data. Buffers previously returned by `data()` and `prepare()` are
+    /// invalidated.
+    void grow(size_type new_capacity)
+    {
+        if (new_capacity <= capacity()) {
+            return;
+        }
+        if (!this->on_heap() && new_capacity <= inline_capacity) {
+            inline_size_ = round_up(new_capacity);
+            return;
+        }
+        const bool was_inline = !this->on_heap();
+        vec_.resize(round_up(new_capacity));
+        if (was_inline) {
+            std::copy(this->inline_data(), this->inline_data() + end_, vec_.begin());
+        }
+    }
+
+    /// Returns the free space following the stored data, first moving the
+    /// data towards the front of the storage if there is no free space.
+    /// Data is only ever moved by a whole number of `alignment` blocks, so
+    /// that for aligned storage the returned buffer starts (and, if the
+    /// storage was full, ends) on an aligned boundary.
+    mutable_buffer prepare()
     {
-        assert(begin_ + count <= end_);
-        begin_ += count;
         if (empty()) {
             clear();
+        } else if (end_ == capacity()) {
+            const size_type shift = begin_ - begin_ % alignment;
+            if (shift > 0) {
+                std::move(this->bytes() + begin_, this->bytes() + end_,
+                          this->bytes() + begin_ - shift);
+                begin_ -= shift;
+                end_ -= shift;
+                history_ = 0;
+            }
         }
+        return io::buffer(this->bytes() + end_, capacity() - end_);
+    }
+
+    /// Appends `count` bytes, previously written into the buffer returned by
+    /// `prepare()`, to the stored data
+    void commit(size_type count)
+    {
+        assert(end_ + count <= capacity());
+        end_ += count;
+    }
+
+    /// Removes `count` bytes from the front of the stored data. They remain
+    /// in the storage until it is next filled, and can be restored by
+    /// `rewind()`.
+    void consume(size_type count)
+    {
+        assert(begin_ + count <= end_);
+        begin_ += count;
+        history_ += count;
     }
 
-    byte_type front() const { return vec_[begin_]; }
+    /// Returns the number of consumed bytes which can be restored by `rewind()`
+    size_type rewindable() const
+    {
+        return history_;
+    }
+
+    /// Restores the last `count` consumed bytes to the front of the stored data
+    void rewind(size_type count)
+    {
+        assert(count <= history_);
+        begin_ -= count;
+        history_ -= count;
+    }
+
+    byte_type front() const { return this->bytes()[begin_]; }
+
+    /// Returns true if the storage has been allocated on the heap
+    bool on_heap() const
+    {
+        return inline_capacity == 0 || !vec_.empty();
+    }
 
 private:
+    static size_type round_up(size_type size)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    // The part of the inline bytes used for `max_size` bytes of storage
+    static size_type inline_size(size_type max_size)
+    {
+        return max_size <= inline_capacity ? round_up(max_size) : 0;
+    }
+
+    // The size of the heap allocation needed for `max_size` bytes of storage
+    static size_type heap_size(size_type max_size)
+    {
+        return max_size <= inline_capacity ? 0 : round_up(max_size);
+    }
+
+    byte_type* bytes()
+    {
+        return this->on_heap() ? vec_.data() : this->inline_data();
+    }
+
+    const byte_type* bytes() const
+    {
+        return this->on_heap() ? vec_.data() : this->inline_data();
+    }
+
     size_type begin_ = 0;
     size_type end_ = 0;
+    size_type history_ = 0;
+    size_type inline_size_ = 0;
     std::vector<byte_type, allocator_type> vec_;
 };
 
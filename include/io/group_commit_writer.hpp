@@ -0,0 +1,163 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_GROUP_COMMIT_WRITER_HPP
+#define IO_GROUP_COMMIT_WRITER_HPP
+
+#include <io/buffer.hpp>
+#include <io/traits.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace io {
+
+namespace detail {
+
+template <typename Stream, typename = void>
+struct has_sync_data : std::false_type {};
+
+template <typename Stream>
+struct has_sync_data<Stream, void_t<
+    decltype(std::declval<Stream&>().sync_data(std::declval<std::error_code&>()))
+>> : std::true_type {};
+
+} // end namespace detail
+
+/// Serialises writes to a file from many threads, and makes them durable in
+/// groups.
+///
+/// Each call to `write()` appends its data to the file and returns a ticket.
+/// Passing the ticket to `commit()` blocks until the data has been flushed to
+/// storage. Whichever committing thread finds no flush in progress performs
+/// one on behalf of every write made so far; threads which arrive while it is
+/// running wait, and are then satisfied together by the next flush. Under
+/// load, the number of flushes is therefore far smaller than the number of
+/// commits.
+///
+/// The next layer is flushed with `sync_data()` if it has one, or `sync()`
+/// otherwise. A failed flush leaves the durability of every outstanding write
+/// unknown, so the error is reported to all current and future commits.
+template <typename Stream>
+class group_commit_writer {
+public:
+    using next_layer_type = std::remove_reference_t<Stream>;
+    using ticket_type = std::uint64_t;
+
+    explicit group_commit_writer(Stream base)
+        : base_(std::forward<Stream>(base))
+    {}
+
+    group_commit_writer(const group_commit_writer&) = delete;
+    group_commit_writer& operator=(const group_commit_writer&) = delete;
+
+    next_layer_type& next_layer() { return base_; }
+
+    const next_layer_type& next_layer() const { return base_; }
+
+    /// Writes all of `cb` to the next layer
+    /// @returns A ticket to pass to `commit()`
+    template <typename ConstBufSeq>
+    ticket_type write(const ConstBufSeq& cb, std::error_code& ec)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        written_ += io::write(base_, cb, ec);
+        return written_;
+    }
+
+    template <typename ConstBufSeq>
+    ticket_type write(const ConstBufSeq& cb)
+    {
+        std::error_code ec;
+        const auto ticket = this->write(cb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return ticket;
+    }
+
+    /// Blocks until every write up to and including the one which returned
+    /// `ticket` has been flushed to storage
+    void commit(ticket_type ticket, std::error_code& ec)
+    {
+        ec.clear();
+        std::unique_lock<std::mutex> lock{mutex_};
+
+        while (true) {
+            if (sync_error_) {
+                ec = sync_error_;
+                return;
+            }
+            if (durable_ >= ticket) {
+                return;
+            }
+            if (!syncing_) {
+                break;
+            }
+            cond_.wait(lock);
+        }
+
+        // Lead a flush covering everything written so far. Other threads can
+        // carry on writing while it runs; their data joins the next group.
+        syncing_ = true;
+        const auto target = written_;
+        lock.unlock();
+
+        std::error_code sync_ec;
+        this->sync(detail::has_sync_data<next_layer_type>{}, sync_ec);
+
+        lock.lock();
+        syncing_ = false;
+        ++sync_count_;
+        if (sync_ec) {
+            sync_error_ = sync_ec;
+        } else {
+            durable_ = target;
+        }
+        cond_.notify_all();
+        ec = sync_ec;
+    }
+
+    void commit(ticket_type ticket)
+    {
+        std::error_code ec;
+        this->commit(ticket, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Returns the number of flushes performed so far
+    std::uint64_t sync_count() const
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return sync_count_;
+    }
+
+private:
+    void sync(std::true_type /*HasSyncData*/, std::error_code& ec)
+    {
+        base_.sync_data(ec);
+    }
+
+    void sync(std::false_type /*HasSyncData*/, std::error_code& ec)
+    {
+        base_.sync(ec);
+    }
+
+    Stream base_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    ticket_type written_ = 0;
+    ticket_type durable_ = 0;
+    bool syncing_ = false;
+    std::error_code sync_error_;
+    std::uint64_t sync_count_ = 0;
+};
+
+} // end namespace io
+
+#endif // IO_GROUP_COMMIT_WRITER_HPP
@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cstring> // for std::memcpy
 #include <io/io_std/string_view.hpp>
 #include <limits>
@@ -32,7 +33,9 @@ namespace net {
 // N.B. std::is_error_code_enum specialisation at end of file
 enum class stream_errc {
     eof = 1,
-    not_found
+    not_found,
+    // EXTENSION -- not in Networking TS
+    would_block
 };
 
 const std::error_category& stream_category() noexcept;
@@ -264,7 +267,7 @@ template <class SyncReadStream, class DynamicBuffer, class CompletionCondition,
 std::size_t read(SyncReadStream& stream, DynamicBuffer&& b,
                  CompletionCondition completion_condition, std::error_code& ec);
 
-// Asynchronous read operations -- NOT IMPLEMENTED
+// Asynchronous read operations -- see io/async.hpp
 
 // Synchronous write operations
 
@@ -312,7 +315,7 @@ std::size_t write(SyncWriteStream& stream, DynamicBuffer&& b,
                   CompletionCondition completion_condition,
                   std::error_code& ec);
 
-// Asynchronous write operations -- NOT IMPLEMENTED
+// Asynchronous write operations -- see io/async.hpp
 
 // Synchronous delimited read operations
 
@@ -331,7 +334,7 @@ std::size_t read_until(SyncReadStream& s, DynamicBuffer&& b,
                        io_std::string_view delim, std::error_code& ec);
 
 
-// Asynchronous delimited read operations -- NOT IMPLEMENTED
+// Asynchronous delimited read operations -- see io/async.hpp
 
 } // end namespace net
 } // end namespace io
@@ -365,6 +368,8 @@ class stream_error_category : public std::error_category
             return "end of file";
         case stream_errc::not_found:
             return "delimiter not found";
+        case stream_errc::would_block:
+            return "operation would block";
         default:
             return "unknown error";
         }
@@ -1135,6 +1140,87 @@ private:
     std::size_t exact_;
 };
 
+namespace detail {
+
+template <typename Stream, typename = void>
+struct has_wait_readable : std::false_type {};
+
+template <typename Stream>
+struct has_wait_readable<Stream, void_t<
+    decltype(std::declval<Stream&>().wait_readable(std::chrono::milliseconds{},
+                                                   std::declval<std::error_code&>()))
+>> : std::true_type {};
+
+template <typename Stream, typename = void>
+struct has_wait_writable : std::false_type {};
+
+template <typename Stream>
+struct has_wait_writable<Stream, void_t<
+    decltype(std::declval<Stream&>().wait_writable(std::chrono::milliseconds{},
+                                                   std::declval<std::error_code&>()))
+>> : std::true_type {};
+
+// EXTENSION -- not in Networking TS
+// Detects the borrowed-read interface of a buffered stream: `data()` returns
+// the buffered bytes, `consume()` discards them and `fill()` reads more
+template <typename Stream, typename = void>
+struct has_borrowed_read : std::false_type {};
+
+template <typename Stream>
+struct has_borrowed_read<Stream, void_t<
+    std::enable_if_t<std::is_convertible<
+        decltype(std::declval<const Stream&>().data()), const_buffer>::value>,
+    decltype(std::declval<Stream&>().consume(std::size_t{})),
+    decltype(std::declval<Stream&>().fill(std::declval<std::error_code&>()))
+>> : std::true_type {};
+
+template <class SyncReadStream>
+void wait_readable(SyncReadStream& stream, std::error_code& ec,
+                   std::true_type /*HasWaitReadable*/)
+{
+    stream.wait_readable(std::chrono::milliseconds{-1}, ec);
+}
+
+template <class SyncReadStream>
+void wait_readable(SyncReadStream&, std::error_code&,
+                   std::false_type /*HasWaitReadable*/)
+{}
+
+template <class SyncWriteStream>
+void wait_writable(SyncWriteStream& stream, std::error_code& ec,
+                   std::true_type /*HasWaitWritable*/)
+{
+    stream.wait_writable(std::chrono::milliseconds{-1}, ec);
+}
+
+template <class SyncWriteStream>
+void wait_writable(SyncWriteStream&, std::error_code&,
+                   std::false_type /*HasWaitWritable*/)
+{}
+
+// EXTENSION -- not in Networking TS
+// If a read from a non-blocking stream reported that it would block, waits
+// until the stream is readable and clears `ec`, so that the caller retries.
+// Streams which cannot be waited on are left to report the error.
+template <class SyncReadStream>
+void wait_if_would_block_on_read(SyncReadStream& stream, std::error_code& ec)
+{
+    if (ec == stream_errc::would_block) {
+        wait_readable(stream, ec, has_wait_readable<SyncReadStream>{});
+    }
+}
+
+// As above, for writes
+template <class SyncWriteStream>
+void wait_if_would_block_on_write(SyncWriteStream& stream, std::error_code& ec)
+{
+    if (ec == stream_errc::would_block) {
+        wait_writable(stream, ec, has_wait_writable<SyncWriteStream>{});
+    }
+}
+
+} // end namespace detail
+
 // 17.5 Synchronous read operations [buffer.read]
 
 // EXTENSION -- not in Networking TS
@@ -1153,6 +1239,7 @@ std::size_t read(SyncReadStream& stream,
     while (total_bytes_read < buf_size && next_read_size != 0) {
         mutable_buffer buf = buffer + total_bytes_read;
         total_bytes_read += stream.read_some(buf, ec);
+        detail::wait_if_would_block_on_read(stream, ec);
         next_read_size = completion_condition(ec, total_bytes_read);
     }
 
@@ -1248,6 +1335,7 @@ std::size_t read(SyncReadStream& stream, DynamicBuffer&& b,
     while (b.size() < b.max_size()) {
         auto buf = b.prepare(next_read_size);
         std::size_t bytes_read = stream.read_some(buf, ec);
+        detail::wait_if_would_block_on_read(stream, ec);
         b.commit(bytes_read);
         total_bytes_read += bytes_read;
         next_read_size = calc_next_read_size(completion_condition(ec, total_bytes_read));
@@ -1259,6 +1347,33 @@ std::size_t read(SyncReadStream& stream, DynamicBuffer&& b,
     return total_bytes_read;
 }
 
+namespace detail {
+
+// Returns the buffers of `buffers` which remain after skipping the first
+// `count` bytes
+template <class ConstBufferSequence>
+std::vector<const_buffer> consume_buffers(const ConstBufferSequence& buffers,
+                                          std::size_t count)
+{
+    std::vector<const_buffer> remaining;
+    auto i = net::buffer_sequence_begin(buffers);
+    auto end = net::buffer_sequence_end(buffers);
+
+    for (; i != end; ++i) {
+        const_buffer b(*i);
+        if (count >= b.size()) {
+            count -= b.size();
+        } else {
+            remaining.push_back(b + count);
+            count = 0;
+        }
+    }
+
+    return remaining;
+}
+
+} // end namespace detail
+
 // 17.7 Synchronous write operations [buffer.write]
 
 template<class SyncWriteStream, class ConstBufferSequence, class>
@@ -1303,7 +1418,14 @@ std::size_t write(SyncWriteStream& stream,
     std::size_t buf_size = buffer_size(buffers);
 
     while (total_bytes_written < buf_size && next_write_size != 0) {
-        total_bytes_written += stream.write_some(buffers, ec);
+        if (total_bytes_written == 0) {
+            total_bytes_written += stream.write_some(buffers, ec);
+        } else {
+            // A previous write was short, so carry on from where it stopped
+            total_bytes_written += stream.write_some(
+                    detail::consume_buffers(buffers, total_bytes_written), ec);
+        }
+        detail::wait_if_would_block_on_write(stream, ec);
         next_write_size = completion_condition(ec, total_bytes_written);
     }
 
@@ -1347,6 +1469,7 @@ std::size_t write(SyncWriteStream& stream, DynamicBuffer&& b,
 
     while (b.size() != 0 && next_write_size != 0) {
         std::size_t bytes_written = stream.write_some(b.data(), ec);
+        detail::wait_if_would_block_on_write(stream, ec);
         total_bytes_written += bytes_written;
         next_write_size = completion_condition(ec, total_bytes_written);
         b.consume(bytes_written);
@@ -1387,41 +1510,145 @@ std::size_t read_until(SyncReadStream& s, DynamicBuffer&& b, io_std::string_view
     return bytes_read;
 }
 
+namespace detail {
+
+// Moves up to `count` bytes from the front of the buffered stream `s` into
+// the dynamic buffer `b`, as far as it has room
+template <class BufferedReadStream, class DynamicBuffer>
+std::size_t move_buffered(BufferedReadStream& s, DynamicBuffer& b, std::size_t count)
+{
+    count = std::min(count, b.max_size() - b.size());
+    const auto bytes_copied = buffer_copy(b.prepare(count), s.data(), count);
+    b.commit(bytes_copied);
+    s.consume(bytes_copied);
+    return bytes_copied;
+}
+
+// Reads from `s` into `b` until the data in `b` contains the delimiter,
+// searching from `search_pos`. Everything in `b` from `start` onwards counts
+// as having been read by this call.
 template<class SyncReadStream, class DynamicBuffer>
-std::size_t read_until(SyncReadStream& s, DynamicBuffer&& b,
-                       io_std::string_view delim, std::error_code& ec)
+std::size_t read_until_search(SyncReadStream& s, DynamicBuffer& b,
+                              io_std::string_view delim, std::error_code& ec,
+                              std::size_t start, std::size_t search_pos)
 {
-    std::size_t total_bytes_read = 0;
-    std::size_t next_read_size = max_single_transfer_size;
-    bool found = false;
+    ec.clear();
 
-    while (!found && b.size() != b.max_size() && !ec) {
-        auto buf = b.prepare(next_read_size);
-        size_t bytes_read = s.read_some(buf, ec);
+    while (true) {
+        if (b.size() == b.max_size()) {
+            ec = stream_errc::not_found;
+            return b.size() - start;
+        }
+
+        const auto read_size = std::min(max_single_transfer_size,
+                                        b.max_size() - b.size());
+        const auto bytes_read = s.read_some(b.prepare(read_size), ec);
+        detail::wait_if_would_block_on_read(s, ec);
         b.commit(bytes_read);
-        const char* data_ptr = static_cast<const char*>(buf.data());
 
-        //const char* delim_ptr = std::find(data_ptr, data_ptr + bytes_read,
-        //                                  delim);
-        const char* delim_ptr = std::search(data_ptr, data_ptr + bytes_read,
-                                            std::begin(delim), std::end(delim));
+        const const_buffer data = b.data();
+        const char* first = static_cast<const char*>(data.data());
+        const char* last = first + data.size();
+        const char* pos = std::search(first + search_pos, last,
+                                      delim.begin(), delim.end());
+
+        if (pos != last) {
+            ec.clear();
+            return static_cast<std::size_t>(pos - first) - start + delim.size();
+        }
 
-        if (delim_ptr != data_ptr + bytes_read) {
-            found = true;
+        // The end of the data could hold the first part of a delimiter
+        if (data.size() >= delim.size()) {
+            search_pos = std::max(search_pos, data.size() - delim.size() + 1);
         }
 
-        total_bytes_read += std::distance(data_ptr, delim_ptr);
+        if (ec == stream_errc::eof) {
+            ec = stream_errc::not_found;
+        }
+        if (ec) {
+            return b.size() - start;
+        }
     }
+}
 
-    if (!found) {
-        ec = stream_errc::not_found;
-    } else {
-        // Hack hack hack!
-        ++total_bytes_read;
-        ec.clear();
+// Searches the stream's own buffer in place, so that each byte is copied
+// only once, into `b`. Bytes after the delimiter are left in the stream.
+template<class SyncReadStream, class DynamicBuffer>
+std::size_t read_until_impl(SyncReadStream& s, DynamicBuffer& b,
+                            io_std::string_view delim, std::error_code& ec,
+                            std::true_type /*HasBorrowedRead*/)
+{
+    std::size_t total_bytes_read = 0;
+    ec.clear();
+
+    while (true) {
+        const const_buffer data = s.data();
+        const char* first = static_cast<const char*>(data.data());
+        const char* last = first + data.size();
+        const char* pos = std::search(first, last, delim.begin(), delim.end());
+
+        if (pos != last) {
+            const std::size_t count = (pos - first) + delim.size();
+            const std::size_t bytes_moved = move_buffered(s, b, count);
+            total_bytes_read += bytes_moved;
+            if (bytes_moved < count) {
+                ec = stream_errc::not_found;
+            }
+            return total_bytes_read;
+        }
+
+        // Keep back anything which could be the start of a delimiter
+        const std::size_t keep = std::min(data.size(), delim.size() - 1);
+        total_bytes_read += move_buffered(s, b, data.size() - keep);
+        if (b.size() == b.max_size()) {
+            ec = stream_errc::not_found;
+            return total_bytes_read;
+        }
+
+        const std::size_t bytes_filled = s.fill(ec);
+        if (!ec && bytes_filled == 0 && keep > 0 && keep == data.size()) {
+            // The stream's buffer is full, but too small to hold a whole
+            // delimiter, so carry on searching in `b` instead
+            const std::size_t start = b.size() - total_bytes_read;
+            const std::size_t search_pos = b.size();
+            if (move_buffered(s, b, keep) < keep) {
+                ec = stream_errc::not_found;
+                return total_bytes_read;
+            }
+            return read_until_search(s, b, delim, ec, start, search_pos);
+        }
+
+        wait_if_would_block_on_read(s, ec);
+        if (ec == stream_errc::eof) {
+            total_bytes_read += move_buffered(s, b, keep);
+            ec = stream_errc::not_found;
+        }
+        if (ec) {
+            return total_bytes_read;
+        }
     }
+}
 
-    return total_bytes_read;
+template<class SyncReadStream, class DynamicBuffer>
+std::size_t read_until_impl(SyncReadStream& s, DynamicBuffer& b,
+                            io_std::string_view delim, std::error_code& ec,
+                            std::false_type /*HasBorrowedRead*/)
+{
+    return read_until_search(s, b, delim, ec, b.size(), b.size());
+}
+
+} // end namespace detail
+
+template<class SyncReadStream, class DynamicBuffer>
+std::size_t read_until(SyncReadStream& s, DynamicBuffer&& b,
+                       io_std::string_view delim, std::error_code& ec)
+{
+    if (delim.empty()) {
+        ec.clear();
+        return 0;
+    }
+    return detail::read_until_impl(s, b, delim, ec,
+                                   detail::has_borrowed_read<SyncReadStream>{});
 }
 
 
@@ -43,7 +43,16 @@ enum class open_mode {
     /// If this flag is specified, a runtime error will occur if the file
     /// already exists.
     /// This is equivalent to the Posix mode `O_CREAT | O_EXCL`
-    always_create = 64
+    always_create = 64,
+    /// Bypass the operating system's page cache, transferring data directly
+    /// between the device and user memory.
+    /// Transfers should use block-aligned buffers, offsets and sizes; a
+    /// buffered stream using an `aligned_allocator` provides these. A file
+    /// opened by path also keeps a second, cached descriptor, through which
+    /// any unaligned transfer (such as the final block of the file) is made.
+    /// This is equivalent to the Linux mode `O_DIRECT`, and is ignored on
+    /// platforms which do not support it
+    direct = 128
 };
 
 /// Bitwise `and` operation for `open_mode`
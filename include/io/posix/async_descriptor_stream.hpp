@@ -0,0 +1,172 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_POSIX_ASYNC_DESCRIPTOR_STREAM_HPP
+#define IO_POSIX_ASYNC_DESCRIPTOR_STREAM_HPP
+
+#include <io/traits.hpp>
+#include <io/posix/descriptor_stream.hpp>
+#include <io/posix/epoll_reactor.hpp>
+
+namespace io {
+namespace posix {
+
+/// A `descriptor_stream` driven by an `epoll_reactor`.
+///
+/// The descriptor is switched to non-blocking mode on construction. Each
+/// asynchronous operation is first attempted immediately; if it would block,
+/// it waits for the descriptor to become ready and then tries again.
+/// Completion handlers are invoked from within the reactor's `run()` with
+/// the signature `void(std::error_code, std::size_t)`, and must be
+/// CopyConstructible. The buffers passed to an operation must remain valid
+/// until its handler is invoked.
+///
+/// At most one read and one write may be outstanding at any time, and the
+/// stream must not be moved while any are.
+class async_descriptor_stream {
+public:
+    using native_handle_type = descriptor_stream::native_handle_type;
+    using next_layer_type = descriptor_stream;
+
+    async_descriptor_stream(epoll_reactor& reactor, file_descriptor_handle fd)
+        : reactor_(&reactor),
+          stream_(std::move(fd))
+    {
+        stream_.set_non_blocking(true);
+    }
+
+    async_descriptor_stream(epoll_reactor& reactor, file_descriptor_handle fd,
+                            std::error_code& ec) noexcept
+        : reactor_(&reactor),
+          stream_(std::move(fd))
+    {
+        stream_.set_non_blocking(true, ec);
+    }
+
+    async_descriptor_stream(async_descriptor_stream&&) noexcept = default;
+
+    /// Cancels any outstanding operations on the current descriptor and
+    /// closes it, before taking over the descriptor of `other`
+    async_descriptor_stream& operator=(async_descriptor_stream&& other) noexcept
+    {
+        if (&other != this) {
+            this->cancel_waits();
+            // Close the old descriptor now that the reactor has forgotten it
+            stream_ = descriptor_stream{};
+            reactor_ = other.reactor_;
+            stream_ = std::move(other.stream_);
+        }
+        return *this;
+    }
+
+    /// Destroys the stream, cancelling any outstanding operations
+    ~async_descriptor_stream()
+    {
+        this->cancel_waits();
+    }
+
+    native_handle_type native_handle() const noexcept
+    {
+        return stream_.native_handle();
+    }
+
+    epoll_reactor& reactor() const noexcept { return *reactor_; }
+
+    next_layer_type& next_layer() noexcept { return stream_; }
+
+    const next_layer_type& next_layer() const noexcept { return stream_; }
+
+    /// Cancels all outstanding operations. Their handlers are invoked with
+    /// `std::errc::operation_canceled`.
+    void cancel()
+    {
+        reactor_->cancel(native_handle());
+    }
+
+    // AsyncReadStream implementation
+
+    template <typename MutBufSeq, typename ReadHandler>
+    void async_read_some(const MutBufSeq& mb, ReadHandler&& handler)
+    {
+        static_assert(is_mutable_buffer_sequence_v<MutBufSeq>,
+                      "Argument passed to async_read_some() is not a MutableBufferSequence");
+
+        this->start_op(std::true_type{}, mb, std::forward<ReadHandler>(handler));
+    }
+
+    // AsyncWriteStream implementation
+
+    template <typename ConstBufSeq, typename WriteHandler>
+    void async_write_some(const ConstBufSeq& cb, WriteHandler&& handler)
+    {
+        static_assert(is_const_buffer_sequence_v<ConstBufSeq>,
+                      "Argument passed to async_write_some() is not a ConstBufferSequence");
+
+        this->start_op(std::false_type{}, cb, std::forward<WriteHandler>(handler));
+    }
+
+private:
+    // Stops the reactor waiting on the descriptor, which must be done before
+    // the descriptor is closed, as its number may be reused
+    void cancel_waits()
+    {
+        if (reactor_ && native_handle() != -1) {
+            reactor_->cancel(native_handle());
+        }
+    }
+
+    template <typename IsRead, typename BufSeq, typename Handler>
+    void start_op(IsRead is_read, const BufSeq& buffers, Handler&& handler)
+    {
+        std::error_code ec;
+        const std::size_t bytes = this->transfer(is_read, buffers, ec);
+
+        if (ec == stream_errc::would_block) {
+            const auto type = is_read ? epoll_reactor::wait_type::read
+                                      : epoll_reactor::wait_type::write;
+            reactor_->async_wait(native_handle(), type,
+                    [this, buffers, handler = std::forward<Handler>(handler)]
+                    (std::error_code wait_ec) mutable {
+                if (wait_ec) {
+                    handler(wait_ec, std::size_t{0});
+                } else {
+                    this->start_op(IsRead{}, buffers, std::move(handler));
+                }
+            });
+            return;
+        }
+
+        reactor_->post([handler = std::forward<Handler>(handler), ec, bytes] () mutable {
+            handler(ec, bytes);
+        });
+    }
+
+    template <typename MutBufSeq>
+    std::size_t transfer(std::true_type /*IsRead*/, const MutBufSeq& mb,
+                         std::error_code& ec)
+    {
+        return stream_.read_some(mb, ec);
+    }
+
+    template <typename ConstBufSeq>
+    std::size_t transfer(std::false_type /*IsRead*/, const ConstBufSeq& cb,
+                         std::error_code& ec)
+    {
+        return stream_.write_some(cb, ec);
+    }
+
+    epoll_reactor* reactor_ = nullptr;
+    descriptor_stream stream_;
+};
+
+static_assert(is_async_read_stream_v<async_descriptor_stream>,
+              "async_descriptor_stream does not meet the AsyncReadStream requirements");
+static_assert(is_async_write_stream_v<async_descriptor_stream>,
+              "async_descriptor_stream does not meet the AsyncWriteStream requirements");
+
+} // end namespace posix
+} // end namespace io
+
+#endif // IO_POSIX_ASYNC_DESCRIPTOR_STREAM_HPP
@@ -10,14 +10,85 @@
 #include <io/buffer.hpp>
 #include <io/traits.hpp>
 #include <io/posix/file_descriptor_handle.hpp>
+#include <io/posix/scatter_gather.hpp>
 
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+
 namespace io {
 namespace posix {
 
+namespace detail {
+
+// Converts the errno value from a failed read or write to an error code,
+// reporting a would-be blocking operation as stream_errc::would_block
+inline std::error_code transfer_error(int err) noexcept
+{
+    if (err == EAGAIN || err == EWOULDBLOCK) {
+        return stream_errc::would_block;
+    }
+    return std::error_code{err, std::system_category()};
+}
+
+/// Waits for at most `timeout` for `fd` to become ready for the operations
+/// in `events`, or indefinitely if `timeout` is negative.
+/// @returns Whether the descriptor became ready. A descriptor which has hung
+/// up or is in an error state counts as ready, so that the next operation can
+/// report what happened.
+inline bool poll_descriptor(int fd, short events,
+                            std::chrono::milliseconds timeout,
+                            std::error_code& ec) noexcept
+{
+    using clock = std::chrono::steady_clock;
+
+    ec.clear();
+
+    // Clamp the timeout so that the deadline cannot overflow
+    const auto start = clock::now();
+    const auto max_timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+            clock::time_point::max() - start);
+    const auto deadline = start + std::min(timeout, max_timeout);
+    ::pollfd pfd{fd, events, 0};
+
+    while (true) {
+        int wait_ms = -1;
+        if (timeout.count() >= 0) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - clock::now());
+            // A long wait is made in several polls of at most INT_MAX ms
+            wait_ms = static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+                    std::max<std::chrono::milliseconds::rep>(remaining.count(), 0),
+                    INT_MAX));
+        }
+
+        errno = 0;
+        const int result = ::poll(&pfd, 1, wait_ms);
+        if (result > 0) {
+            return true;
+        }
+        if (result == 0) {
+            if (wait_ms == INT_MAX) {
+                continue;
+            }
+            return false;
+        }
+        if (errno != EINTR) {
+            ec.assign(errno, std::system_category());
+            return false;
+        }
+    }
+}
+
+} // end namespace detail
+
 struct descriptor_stream {
     using native_handle_type = int;
 
@@ -28,6 +99,94 @@ struct descriptor_stream {
 
     native_handle_type native_handle() const noexcept { return fd_.get(); }
 
+    /// Puts the descriptor into or out of non-blocking mode. In non-blocking
+    /// mode, reads and writes which cannot make progress immediately fail
+    /// with `stream_errc::would_block`; `io::read()`, `io::write()` and
+    /// `io::read_until()` handle this by waiting for the descriptor to become
+    /// ready.
+    void set_non_blocking(bool enable, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+        const int flags = ::fcntl(native_handle(), F_GETFL);
+        if (flags == -1) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+
+        const int new_flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        if (new_flags != flags && ::fcntl(native_handle(), F_SETFL, new_flags) == -1) {
+            ec.assign(errno, std::system_category());
+        }
+    }
+
+    void set_non_blocking(bool enable)
+    {
+        std::error_code ec;
+        this->set_non_blocking(enable, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    bool non_blocking(std::error_code& ec) const noexcept
+    {
+        ec.clear();
+        errno = 0;
+        const int flags = ::fcntl(native_handle(), F_GETFL);
+        if (flags == -1) {
+            ec.assign(errno, std::system_category());
+            return false;
+        }
+        return (flags & O_NONBLOCK) != 0;
+    }
+
+    bool non_blocking() const
+    {
+        std::error_code ec;
+        const bool result = this->non_blocking(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return result;
+    }
+
+    /// Waits for at most `timeout` for the descriptor to become readable, or
+    /// indefinitely if `timeout` is negative.
+    /// @returns Whether the descriptor became readable before the timeout
+    bool wait_readable(std::chrono::milliseconds timeout, std::error_code& ec) noexcept
+    {
+        return detail::poll_descriptor(native_handle(), POLLIN, timeout, ec);
+    }
+
+    bool wait_readable(std::chrono::milliseconds timeout)
+    {
+        std::error_code ec;
+        const bool ready = this->wait_readable(timeout, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return ready;
+    }
+
+    /// Waits for at most `timeout` for the descriptor to become writable, or
+    /// indefinitely if `timeout` is negative.
+    /// @returns Whether the descriptor became writable before the timeout
+    bool wait_writable(std::chrono::milliseconds timeout, std::error_code& ec) noexcept
+    {
+        return detail::poll_descriptor(native_handle(), POLLOUT, timeout, ec);
+    }
+
+    bool wait_writable(std::chrono::milliseconds timeout)
+    {
+        std::error_code ec;
+        const bool ready = this->wait_writable(timeout, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return ready;
+    }
+
     // SyncReadStream implementation
 
     template <typename MutBufSeq>
@@ -56,30 +215,19 @@ struct descriptor_stream {
             return 0;
         }
 
-        // Prepare buffers
-        constexpr int max_iovec = 16; //?
-        std::array<::iovec, max_iovec> io_vecs{};
-
-        int i = 0;
-        for (auto it = buffer_sequence_begin(mb);
-             it != buffer_sequence_end(mb); ++it) {
-            io_vecs[i].iov_base = it->data();
-            io_vecs[i].iov_len = it->size();
-            if (++i == max_iovec) {
-                break;
-            }
-        }
-
-        auto bytes = ::readv(native_handle(), io_vecs.data(), i);
+        // Only attempt the first chunk: a further read from a pipe or socket
+        // could block even though we already have data
+        auto bytes = detail::transfer_buffer_sequence(mb, false,
+                [&] (const ::iovec* iovs, int count, std::size_t) {
+            return ::readv(native_handle(), iovs, count);
+        });
 
         if (bytes == 0) {
             ec = stream_errc::eof;
         }
         else if (bytes < 0) {
-            ec.assign(errno, std::system_category());
-        }
-        else {
-            ec.clear();
+            ec = detail::transfer_error(errno);
+            return 0;
         }
 
         return bytes;
@@ -99,7 +247,8 @@ struct descriptor_stream {
             ec = stream_errc::eof;
         }
         else if (bytes_read < 0) {
-            ec.assign(errno, std::system_category());
+            ec = detail::transfer_error(errno);
+            return 0;
         }
 
         return bytes_read;
@@ -108,8 +257,8 @@ struct descriptor_stream {
     // SyncWriteStream implementation
 
     template <typename ConstBufSeq,
-              typename = std::enable_if_t<is_const_buffer_sequence_v<ConstBufSeq>>
-    std::size_t write_some(ConstBufSeq& cb)
+              typename = std::enable_if_t<is_const_buffer_sequence_v<ConstBufSeq>>>
+    std::size_t write_some(const ConstBufSeq& cb)
     {
         std::error_code ec;
         auto sz = write_some(cb, ec);
@@ -122,38 +271,29 @@ struct descriptor_stream {
     }
 
     template <typename ConstBufSeq,
-              typename = std::enable_if_t<is_const_buffer_sequence_v<ConstBufSeq>>
-    std::size_t write_some(ConstBufSeq& cb, std::error_code& ec) noexcept
+              typename = std::enable_if_t<is_const_buffer_sequence_v<ConstBufSeq>>>
+    std::size_t write_some(const ConstBufSeq& cb, std::error_code& ec) noexcept
     {
+        ec.clear();
+
         if (io::buffer_size(cb) == 0) {
-            ec.clear();
             return 0;
         }
 
-        // Prepare buffers
-        constexpr int max_iovec = 16; //?
-        std::array<::iovec, max_iovec> io_vecs{};
-
-        int i = 0;
-        for (auto it = buffer_sequence_begin(cb);
-             it != buffer_sequence_end(cb); ++it) {
-            io_vecs[i].iov_base = it->data();
-            io_vecs[i].iov_len = it->size();
-            if (++i == max_iovec) {
-                break;
-            }
-        }
-
-        auto bytes_written = ::writev(native_handle(), io_vecs.data(), i);
+        auto bytes_written = detail::transfer_buffer_sequence(cb, true,
+                [&] (const ::iovec* iovs, int count, std::size_t) {
+            return ::writev(native_handle(), iovs, count);
+        });
 
         if (bytes_written < 0) {
-            ec.assign(errno, std::system_category());
+            ec = detail::transfer_error(errno);
+            return 0;
         }
 
         return bytes_written;
     }
 
-    std::size_t write_some(const io::mutable_buffer& cb, std::error_code& ec)
+    std::size_t write_some(const io::const_buffer& cb, std::error_code& ec)
     {
         ec.clear();
 
@@ -164,7 +304,8 @@ struct descriptor_stream {
         auto bytes_written = ::write(native_handle(), cb.data(), cb.size());
 
         if (bytes_written < 0) {
-            ec.assign(errno, std::system_category());
+            ec = detail::transfer_error(errno);
+            return 0;
         }
 
         return bytes_written;
@@ -0,0 +1,335 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_POSIX_EPOLL_REACTOR_HPP
+#define IO_POSIX_EPOLL_REACTOR_HPP
+
+#ifndef __linux__
+#error "The epoll reactor is only available on Linux"
+#endif
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+namespace io {
+namespace posix {
+
+/// A single-threaded readiness notifier built on Linux epoll.
+///
+/// Handlers waiting for a descriptor to become readable or writable are
+/// queued with `async_wait()`, and are invoked from within `run()` or
+/// `run_one()` once the descriptor is ready. Handlers are never invoked from
+/// within the function which queued them: completions which are known
+/// immediately are deferred with `post()`.
+///
+/// A reactor is not thread-safe: all its member functions must be called from
+/// the thread which is running it.
+class epoll_reactor {
+public:
+    /// The kind of readiness to wait for
+    enum class wait_type {
+        read,
+        write
+    };
+
+    using wait_handler = std::function<void(std::error_code)>;
+
+    /// The maximum number of readiness events collected by one `epoll_wait()`
+    static constexpr int max_events = 64;
+
+    epoll_reactor()
+    {
+        std::error_code ec;
+        this->open(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    explicit epoll_reactor(std::error_code& ec) noexcept
+    {
+        this->open(ec);
+    }
+
+    epoll_reactor(const epoll_reactor&) = delete;
+    epoll_reactor& operator=(const epoll_reactor&) = delete;
+
+    /// Destroys the reactor. Handlers which have not been invoked are
+    /// destroyed without being called.
+    ~epoll_reactor()
+    {
+        if (epoll_fd_ != -1) {
+            ::close(epoll_fd_);
+        }
+    }
+
+    bool is_open() const noexcept { return epoll_fd_ != -1; }
+
+    int native_handle() const noexcept { return epoll_fd_; }
+
+    /// Returns the number of handlers which have yet to be invoked
+    std::size_t pending() const noexcept
+    {
+        return ready_.size() + waiting_;
+    }
+
+    /// Queues `handler` to be invoked by `run()` or `run_one()`
+    void post(std::function<void()> handler)
+    {
+        ready_.push_back(std::move(handler));
+    }
+
+    /// Queues `handler` to be invoked once `fd` is ready for the kind of
+    /// operation given by `type`. The handler is passed an error if the
+    /// descriptor cannot be waited on (for example, if it refers to a regular
+    /// file), or if the wait is cancelled.
+    ///
+    /// Readiness may be spurious, so the handler should retry its operation
+    /// and wait again if it would still block.
+    ///
+    /// The descriptor stays registered with epoll after its waits complete,
+    /// so that waiting on it again costs a single `epoll_ctl()` call.
+    void async_wait(int fd, wait_type type, wait_handler handler)
+    {
+        auto& state = descriptors_[fd];
+        state.waiters[index(type)].push_back(std::move(handler));
+        ++waiting_;
+
+        std::error_code ec;
+        this->update_registration(fd, state, ec);
+        if (ec) {
+            this->complete_all(fd, ec);
+        }
+    }
+
+    /// Completes every wait on `fd` with `std::errc::operation_canceled` and
+    /// stops monitoring it. This must be called before a descriptor which has
+    /// been waited on is closed, as its number may be reused.
+    void cancel(int fd)
+    {
+        this->complete_all(fd, std::make_error_code(std::errc::operation_canceled));
+    }
+
+    /// Runs handlers until none remain
+    /// @returns The number of handlers which were invoked
+    std::size_t run(std::error_code& ec)
+    {
+        std::size_t count = 0;
+        while (this->run_one(ec) != 0) {
+            ++count;
+        }
+        return count;
+    }
+
+    std::size_t run()
+    {
+        std::error_code ec;
+        auto count = this->run(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return count;
+    }
+
+    /// Invokes a single handler, blocking until one is ready if necessary
+    /// @returns The number of handlers which were invoked, which is zero if
+    /// there is nothing left to wait for
+    std::size_t run_one(std::error_code& ec)
+    {
+        ec.clear();
+
+        while (ready_.empty()) {
+            if (waiting_ == 0) {
+                return 0;
+            }
+            this->wait_for_events(ec);
+            if (ec) {
+                return 0;
+            }
+        }
+
+        auto handler = std::move(ready_.front());
+        ready_.pop_front();
+        handler();
+        return 1;
+    }
+
+    std::size_t run_one()
+    {
+        std::error_code ec;
+        auto count = this->run_one(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return count;
+    }
+
+private:
+    struct descriptor_state {
+        std::deque<wait_handler> waiters[2];
+        // The events epoll is armed to report, which is none once it has
+        // reported one, until the descriptor is rearmed
+        std::uint32_t events = 0;
+        bool registered = false;
+    };
+
+    static constexpr int index(wait_type type) noexcept
+    {
+        return type == wait_type::read ? 0 : 1;
+    }
+
+    void open(std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ == -1) {
+            ec.assign(errno, std::system_category());
+        }
+    }
+
+    // Arms epoll to report the events that the waiters on `fd` are waiting
+    // for. Descriptors are registered with EPOLLONESHOT, so that once an
+    // event has been reported nothing more is reported until they are
+    // rearmed; descriptors with no waiters can therefore be left registered.
+    void update_registration(int fd, descriptor_state& state, std::error_code& ec)
+    {
+        ec.clear();
+
+        std::uint32_t events = 0;
+        if (!state.waiters[index(wait_type::read)].empty()) {
+            events |= EPOLLIN;
+        }
+        if (!state.waiters[index(wait_type::write)].empty()) {
+            events |= EPOLLOUT;
+        }
+
+        if ((events & ~state.events) == 0) {
+            return;
+        }
+
+        ::epoll_event event{};
+        event.events = events | EPOLLONESHOT;
+        event.data.fd = fd;
+
+        errno = 0;
+        int result = ::epoll_ctl(epoll_fd_,
+                                 state.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                                 fd, &event);
+        // If the descriptor was closed without being cancelled, the kernel
+        // has removed it for us and its number may now be in use again
+        if (result != 0 && state.registered && errno == ENOENT) {
+            errno = 0;
+            result = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        }
+
+        if (result != 0) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+        state.events = events;
+        state.registered = true;
+    }
+
+    // Removes `fd` from the epoll interest set and forgets about it
+    void deregister(int fd)
+    {
+        auto it = descriptors_.find(fd);
+        if (it == descriptors_.end()) {
+            return;
+        }
+        // The descriptor may already have been closed, in which case the
+        // kernel has removed it for us, so errors are ignored
+        if (it->second.registered) {
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        descriptors_.erase(it);
+    }
+
+    // Moves the waiters of one kind on `fd` to the ready queue
+    void make_ready(descriptor_state& state, wait_type type, std::error_code ec)
+    {
+        auto& waiters = state.waiters[index(type)];
+        waiting_ -= waiters.size();
+        for (auto& handler : waiters) {
+            ready_.push_back([handler = std::move(handler), ec] {
+                handler(ec);
+            });
+        }
+        waiters.clear();
+    }
+
+    void complete_all(int fd, std::error_code ec)
+    {
+        auto it = descriptors_.find(fd);
+        if (it == descriptors_.end()) {
+            return;
+        }
+
+        this->make_ready(it->second, wait_type::read, ec);
+        this->make_ready(it->second, wait_type::write, ec);
+        this->deregister(fd);
+    }
+
+    void wait_for_events(std::error_code& ec)
+    {
+        ::epoll_event events[max_events];
+
+        int count = 0;
+        do {
+            errno = 0;
+            count = ::epoll_wait(epoll_fd_, events, max_events, -1);
+        } while (count < 0 && errno == EINTR);
+
+        if (count < 0) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            const int fd = events[i].data.fd;
+            auto it = descriptors_.find(fd);
+            if (it == descriptors_.end()) {
+                continue;
+            }
+
+            // The event disarmed the descriptor. Errors and hangups are
+            // reported to both directions, so that the retried operation can
+            // discover what went wrong
+            it->second.events = 0;
+            const std::uint32_t ev = events[i].events;
+            if (ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                this->make_ready(it->second, wait_type::read, {});
+            }
+            if (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                this->make_ready(it->second, wait_type::write, {});
+            }
+
+            std::error_code reg_ec;
+            this->update_registration(fd, it->second, reg_ec);
+            if (reg_ec) {
+                this->complete_all(fd, reg_ec);
+            }
+        }
+    }
+
+    int epoll_fd_ = -1;
+    std::unordered_map<int, descriptor_state> descriptors_;
+    std::deque<std::function<void()>> ready_;
+    std::size_t waiting_ = 0;
+};
+
+} // end namespace posix
+} // end namespace io
+
+#endif // IO_POSIX_EPOLL_REACTOR_HPP
@@ -6,19 +6,21 @@
 #ifndef IO_POSIX_FILE_HPP
 #define IO_POSIX_FILE_HPP
 
+#include <io/access_hint.hpp>
 #include <io/io_std/filesystem.hpp>
 #include <io/open_mode.hpp>
 #include <io/seek.hpp>
 #include <io/stream_position.hpp>
+#include <io/sync_range_flags.hpp>
 #include <io/posix/file_descriptor_handle.hpp>
+#include <io/posix/scatter_gather.hpp>
 
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
-#include <array>
-
 namespace io {
 namespace posix {
 
@@ -61,10 +63,37 @@ constexpr int open_mode_to_posix_mode(open_mode m)
     if ((m & open_mode::always_create) != static_cast<open_mode>(0)) {
         p |= (O_CREAT | O_EXCL);
     }
+#ifdef O_DIRECT
+    if ((m & open_mode::direct) != static_cast<open_mode>(0)) {
+        p |= O_DIRECT;
+    }
+#endif
 
     return p;
 }
 
+#ifdef POSIX_FADV_NORMAL
+constexpr int access_hint_to_fadvise_arg(access_hint h)
+{
+    switch (h) {
+    case access_hint::normal:
+        return POSIX_FADV_NORMAL;
+    case access_hint::sequential:
+        return POSIX_FADV_SEQUENTIAL;
+    case access_hint::random:
+        return POSIX_FADV_RANDOM;
+    case access_hint::willneed:
+        return POSIX_FADV_WILLNEED;
+    case access_hint::dontneed:
+        return POSIX_FADV_DONTNEED;
+    case access_hint::noreuse:
+        return POSIX_FADV_NOREUSE;
+    default:
+        return -1;
+    }
+}
+#endif // POSIX_FADV_NORMAL
+
 } // end namespace detail
 
 
@@ -127,6 +156,13 @@ public:
         }
 
         fd_ = posix::file_descriptor_handle{new_fd};
+        buffered_fd_ = posix::file_descriptor_handle{};
+        append_ = (mode & O_APPEND) != 0;
+#ifdef O_DIRECT
+        if ((mode & O_DIRECT) != 0) {
+            this->open_buffered_fd(path, mode);
+        }
+#endif
     }
 
     void close()
@@ -140,11 +176,22 @@ public:
 
     void close(std::error_code& ec) noexcept
     {
-        fd_.close(ec);
+        if (buffered_fd_.get() != -1) {
+            buffered_fd_.close(ec);
+        }
+        std::error_code fd_ec;
+        fd_.close(fd_ec);
+        if (!ec) {
+            ec = fd_ec;
+        }
     }
 
     native_handle_type native_handle() const noexcept { return fd_.get(); }
 
+    /// Returns whether the file was opened in append mode, so that every
+    /// write goes to the end of the file regardless of the cursor
+    bool is_append() const noexcept { return append_; }
+
     // SyncReadStream implementation
 
     template <typename MutBufSeq>
@@ -170,30 +217,23 @@ public:
             return 0;
         }
 
-        // Prepare buffers
-        constexpr int max_iovec = 16; //?
-        std::array<::iovec, max_iovec> io_vecs{};
-
-        int i = 0;
-        for (auto it = buffer_sequence_begin(mb);
-             it != buffer_sequence_end(mb); ++it) {
-            io_vecs[i].iov_base = it->data();
-            io_vecs[i].iov_len = it->size();
-            if (++i == max_iovec) {
-                break;
-            }
-        }
-
-        auto bytes = ::readv(native_handle(), io_vecs.data(), i);
+        auto bytes = detail::transfer_buffer_sequence(mb, true,
+                [&] (const ::iovec* iovs, int count, std::size_t) {
+            return this->with_buffered_fallback([&] {
+                return ::readv(native_handle(), iovs, count);
+            }, [&] (int fd) {
+                return this->at_cursor([&] (offset_type pos) {
+                    return ::preadv(fd, iovs, count, pos);
+                });
+            });
+        });
 
         if (bytes == 0) {
             ec = stream_errc::eof;
         }
         else if (bytes < 0) {
             ec.assign(errno, std::system_category());
-        }
-        else {
-            ec.clear();
+            return 0;
         }
 
         return bytes;
@@ -207,13 +247,20 @@ public:
             return 0;
         }
 
-        auto bytes_read = ::read(native_handle(), mb.data(), mb.size());
+        auto bytes_read = this->with_buffered_fallback([&] {
+            return ::read(native_handle(), mb.data(), mb.size());
+        }, [&] (int fd) {
+            return this->at_cursor([&] (offset_type pos) {
+                return ::pread(fd, mb.data(), mb.size(), pos);
+            });
+        });
 
         if (bytes_read == 0) {
             ec = stream_errc::eof;
         }
         else if (bytes_read < 0) {
             ec.assign(errno, std::system_category());
+            return 0;
         }
 
         return bytes_read;
@@ -222,7 +269,7 @@ public:
     // SyncWriteStream implementation
 
     template <typename ConstBufSeq>
-    std::size_t write_some(ConstBufSeq& cb)
+    std::size_t write_some(const ConstBufSeq& cb)
     {
         std::error_code ec;
         auto sz = write_some(cb, ec);
@@ -235,7 +282,7 @@ public:
     }
 
     template <typename ConstBufSeq>
-    std::size_t write_some(ConstBufSeq& cb, std::error_code& ec) noexcept
+    std::size_t write_some(const ConstBufSeq& cb, std::error_code& ec) noexcept
     {
         static_assert(is_const_buffer_sequence_v<ConstBufSeq>,
                       "Argument passed to write_some() is not a ConstBufferSequence");
@@ -245,30 +292,174 @@ public:
             return 0;
         }
 
-        // Prepare buffers
-        constexpr int max_iovec = 16; //?
-        std::array<::iovec, max_iovec> io_vecs{};
+        auto bytes_written = detail::transfer_buffer_sequence(cb, true,
+                [&] (const ::iovec* iovs, int count, std::size_t) {
+            return this->with_buffered_fallback([&] {
+                return ::writev(native_handle(), iovs, count);
+            }, [&] (int fd) {
+                return this->at_cursor([&] (offset_type pos) {
+                    return ::pwritev(fd, iovs, count, pos);
+                });
+            });
+        });
 
-        int i = 0;
-        for (auto it = buffer_sequence_begin(cb);
-             it != buffer_sequence_end(cb); ++it) {
-            io_vecs[i].iov_base = it->data();
-            io_vecs[i].iov_len = it->size();
-            if (++i == max_iovec) {
-                break;
-            }
+        if (bytes_written < 0) {
+            ec.assign(errno, std::system_category());
+            return 0;
         }
 
-        auto bytes_written = ::writev(native_handle(), io_vecs.data(), i);
+        return bytes_written;
+    }
+
+    std::size_t write_some(const io::const_buffer& cb, std::error_code& ec)
+    {
+        ec.clear();
+
+        if (cb.size() == 0) {
+            return 0;
+        }
+
+        auto bytes_written = this->with_buffered_fallback([&] {
+            return ::write(native_handle(), cb.data(), cb.size());
+        }, [&] (int fd) {
+            return this->at_cursor([&] (offset_type pos) {
+                return ::pwrite(fd, cb.data(), cb.size(), pos);
+            });
+        });
 
         if (bytes_written < 0) {
             ec.assign(errno, std::system_category());
+            return 0;
         }
 
         return bytes_written;
     }
 
-    std::size_t write_some(const io::const_buffer& cb, std::error_code& ec)
+    // RandomAccessReadStream implementation
+
+    /// Reads some bytes starting at `offset` from the start of the file,
+    /// without using or modifying the file cursor. Any number of threads may
+    /// call this concurrently on the same file.
+    template <typename MutBufSeq>
+    std::size_t read_some_at(offset_type offset, const MutBufSeq& mb)
+    {
+        std::error_code ec;
+        auto sz = this->read_some_at(offset, mb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return sz;
+    }
+
+    template <typename MutBufSeq>
+    std::size_t read_some_at(offset_type offset, const MutBufSeq& mb,
+                             std::error_code& ec) noexcept
+    {
+        static_assert(is_mutable_buffer_sequence_v<MutBufSeq>,
+                      "Argument passed to read_some_at() is not a MutableBufferSequence");
+
+        ec.clear();
+
+        if (buffer_size(mb) == 0) {
+            return 0;
+        }
+
+        auto bytes = detail::transfer_buffer_sequence(mb, true,
+                [&] (const ::iovec* iovs, int count, std::size_t done) {
+            const auto pos = offset + static_cast<offset_type>(done);
+            return this->with_buffered_fallback([&] {
+                return ::preadv(native_handle(), iovs, count, pos);
+            }, [&] (int fd) {
+                return ::preadv(fd, iovs, count, pos);
+            });
+        });
+
+        if (bytes == 0) {
+            ec = stream_errc::eof;
+        }
+        else if (bytes < 0) {
+            ec.assign(errno, std::system_category());
+            return 0;
+        }
+
+        return bytes;
+    }
+
+    std::size_t read_some_at(offset_type offset, const io::mutable_buffer& mb,
+                             std::error_code& ec) noexcept
+    {
+        ec.clear();
+
+        if (mb.size() == 0) {
+            return 0;
+        }
+
+        auto bytes_read = this->with_buffered_fallback([&] {
+            return ::pread(native_handle(), mb.data(), mb.size(), offset);
+        }, [&] (int fd) {
+            return ::pread(fd, mb.data(), mb.size(), offset);
+        });
+
+        if (bytes_read == 0) {
+            ec = stream_errc::eof;
+        }
+        else if (bytes_read < 0) {
+            ec.assign(errno, std::system_category());
+            return 0;
+        }
+
+        return bytes_read;
+    }
+
+    // RandomAccessWriteStream implementation
+
+    /// Writes some bytes starting at `offset` from the start of the file,
+    /// without using or modifying the file cursor. Any number of threads may
+    /// call this concurrently on the same file.
+    template <typename ConstBufSeq>
+    std::size_t write_some_at(offset_type offset, const ConstBufSeq& cb)
+    {
+        std::error_code ec;
+        auto sz = this->write_some_at(offset, cb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return sz;
+    }
+
+    template <typename ConstBufSeq>
+    std::size_t write_some_at(offset_type offset, const ConstBufSeq& cb,
+                              std::error_code& ec) noexcept
+    {
+        static_assert(is_const_buffer_sequence_v<ConstBufSeq>,
+                      "Argument passed to write_some_at() is not a ConstBufferSequence");
+
+        ec.clear();
+
+        if (io::buffer_size(cb) == 0) {
+            return 0;
+        }
+
+        auto bytes_written = detail::transfer_buffer_sequence(cb, true,
+                [&] (const ::iovec* iovs, int count, std::size_t done) {
+            const auto pos = offset + static_cast<offset_type>(done);
+            return this->with_buffered_fallback([&] {
+                return ::pwritev(native_handle(), iovs, count, pos);
+            }, [&] (int fd) {
+                return ::pwritev(fd, iovs, count, pos);
+            });
+        });
+
+        if (bytes_written < 0) {
+            ec.assign(errno, std::system_category());
+            return 0;
+        }
+
+        return bytes_written;
+    }
+
+    std::size_t write_some_at(offset_type offset, const io::const_buffer& cb,
+                              std::error_code& ec) noexcept
     {
         ec.clear();
 
@@ -276,10 +467,15 @@ public:
             return 0;
         }
 
-        auto bytes_written = ::write(native_handle(), cb.data(), cb.size());
+        auto bytes_written = this->with_buffered_fallback([&] {
+            return ::pwrite(native_handle(), cb.data(), cb.size(), offset);
+        }, [&] (int fd) {
+            return ::pwrite(fd, cb.data(), cb.size(), offset);
+        });
 
         if (bytes_written < 0) {
             ec.assign(errno, std::system_category());
+            return 0;
         }
 
         return bytes_written;
@@ -328,8 +524,235 @@ public:
         }
     }
 
+    /// Flushes the file's data to storage, along with only as much metadata
+    /// as is needed to read it back (such as the file size, but not the
+    /// modification time). This is often much cheaper than `sync()`.
+    void sync_data(std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+        if (::fdatasync(this->native_handle()) != 0) {
+#else
+        if (::fsync(this->native_handle()) != 0) {
+#endif
+            ec.assign(errno, std::system_category());
+        }
+    }
+
+    void sync_data()
+    {
+        std::error_code ec{};
+        this->sync_data(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Writes back the dirty pages in the byte range `[offset, offset + len)`
+    /// as specified by `flags`, where a `len` of zero means "to the end of the
+    /// file".
+    ///
+    /// This flushes neither metadata nor the device's write cache, so is not
+    /// by itself a durability guarantee. It is useful for starting write-out
+    /// early (`sync_range_flags::write`) so that a later `sync_data()` has
+    /// less to do. Where `sync_file_range()` is unavailable, a request to
+    /// wait for write-out falls back to `sync_data()`.
+    void sync_range(offset_type offset, offset_type len, sync_range_flags flags,
+                    std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+#ifdef SYNC_FILE_RANGE_WRITE
+        unsigned int native_flags = 0;
+        if ((flags & sync_range_flags::wait_before) == sync_range_flags::wait_before) {
+            native_flags |= SYNC_FILE_RANGE_WAIT_BEFORE;
+        }
+        if ((flags & sync_range_flags::write) == sync_range_flags::write) {
+            native_flags |= SYNC_FILE_RANGE_WRITE;
+        }
+        if ((flags & sync_range_flags::wait_after) == sync_range_flags::wait_after) {
+            native_flags |= SYNC_FILE_RANGE_WAIT_AFTER;
+        }
+        if (::sync_file_range(this->native_handle(), offset, len, native_flags) != 0) {
+            ec.assign(errno, std::system_category());
+        }
+#else
+        (void) offset;
+        (void) len;
+        if ((flags & sync_range_flags::wait_after) == sync_range_flags::wait_after) {
+            this->sync_data(ec);
+        }
+#endif
+    }
+
+    void sync_range(offset_type offset, offset_type len, sync_range_flags flags)
+    {
+        std::error_code ec{};
+        this->sync_range(offset, len, flags, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Allocates disk space for the byte range `[offset, offset + len)` of the
+    /// file, extending the file size if necessary. Subsequent writes to the
+    /// range are guaranteed not to fail for lack of space, and a large range
+    /// allocated at once is far less likely to be fragmented.
+    void allocate(offset_type offset, offset_type len, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+
+        if (len == 0) {
+            return;
+        }
+
+#ifdef __linux__
+        if (::fallocate(native_handle(), 0, offset, len) == 0) {
+            return;
+        }
+        if (errno != EOPNOTSUPP) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+        // Otherwise the filesystem does not support fallocate(), so let
+        // posix_fallocate() emulate it
+#endif
+#if defined(_POSIX_ADVISORY_INFO) && _POSIX_ADVISORY_INFO > 0
+        // posix_fallocate() returns the error number rather than setting errno
+        const int err = ::posix_fallocate(native_handle(), offset, len);
+        if (err != 0) {
+            ec.assign(err, std::system_category());
+        }
+#else
+        (void) offset;
+        ec = std::make_error_code(std::errc::operation_not_supported);
+#endif
+    }
+
+    void allocate(offset_type offset, offset_type len)
+    {
+        std::error_code ec;
+        this->allocate(offset, len, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Truncates or extends the file to exactly `len` bytes. Extending the
+    /// file fills the new space with zeros. The file cursor is not moved.
+    void resize(offset_type len, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+        if (::ftruncate(native_handle(), len) != 0) {
+            ec.assign(errno, std::system_category());
+        }
+    }
+
+    void resize(offset_type len)
+    {
+        std::error_code ec;
+        this->resize(len, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Advises the operating system how the byte range `[offset, offset + len)`
+    /// of the file will be accessed. A `len` of zero extends the range to the
+    /// end of the file. On platforms without `posix_fadvise()` this does
+    /// nothing.
+    void advise(offset_type offset, offset_type len, access_hint hint,
+                std::error_code& ec) noexcept
+    {
+        ec.clear();
+#ifdef POSIX_FADV_NORMAL
+        // posix_fadvise() returns the error number rather than setting errno
+        const int err = ::posix_fadvise(native_handle(), offset, len,
+                                        detail::access_hint_to_fadvise_arg(hint));
+        if (err != 0) {
+            ec.assign(err, std::system_category());
+        }
+#else
+        (void) offset; (void) len; (void) hint;
+#endif
+    }
+
+    void advise(offset_type offset, offset_type len, access_hint hint)
+    {
+        std::error_code ec;
+        this->advise(offset, len, hint, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
 private:
+#ifdef O_DIRECT
+    // Opens a second descriptor for the file without O_DIRECT, for transfers
+    // which direct I/O cannot perform. If the path no longer names the file
+    // we opened, there is no fallback.
+    void open_buffered_fd(const io_std::filesystem::path& path, int mode) noexcept
+    {
+        const int saved_errno = errno;
+        const int flags = mode & ~(O_DIRECT | O_CREAT | O_EXCL | O_TRUNC | O_APPEND);
+        const int raw_fd = ::open(path.c_str(), flags);
+        if (raw_fd < 0) {
+            errno = saved_errno;
+            return;
+        }
+        file_descriptor_handle fd{raw_fd};
+
+        struct ::stat direct_st;
+        struct ::stat buffered_st;
+        if (::fstat(fd_.get(), &direct_st) == 0 &&
+            ::fstat(fd.get(), &buffered_st) == 0 &&
+            direct_st.st_dev == buffered_st.st_dev &&
+            direct_st.st_ino == buffered_st.st_ino) {
+            buffered_fd_ = std::move(fd);
+        }
+        errno = saved_errno;
+    }
+#endif
+
+    // Direct I/O transfers must be block-aligned. The kernel rejects anything
+    // else (such as the final, partial block of a file) with EINVAL, in which
+    // case the transfer is retried through the descriptor opened without
+    // O_DIRECT. The flags of the main descriptor are shared with every
+    // duplicate of it, so are never changed.
+    template <typename Operation, typename Fallback>
+    auto with_buffered_fallback(Operation op, Fallback fallback) -> decltype(op())
+    {
+        auto ret = op();
+        if (ret < 0 && errno == EINVAL && buffered_fd_.get() != -1) {
+            ret = fallback(buffered_fd_.get());
+        }
+        return ret;
+    }
+
+    // Performs a positional transfer at the cursor of the main descriptor
+    // (or at the end of the file, in append mode), and then advances the
+    // cursor past it
+    template <typename Transfer>
+    ::ssize_t at_cursor(Transfer transfer)
+    {
+        const offset_type pos = ::lseek(fd_.get(), 0, append_ ? SEEK_END : SEEK_CUR);
+        if (pos < 0) {
+            return -1;
+        }
+        const ::ssize_t ret = transfer(pos);
+        if (ret > 0 && ::lseek(fd_.get(), pos + ret, SEEK_SET) < 0) {
+            return -1;
+        }
+        return ret;
+    }
+
     file_descriptor_handle fd_{};
+    // Without O_DIRECT, if fd_ was opened with it
+    file_descriptor_handle buffered_fd_{};
+    bool append_ = false;
 };
 
 } // end namespace posix
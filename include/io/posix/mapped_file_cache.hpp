@@ -0,0 +1,251 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_POSIX_MAPPED_FILE_CACHE_HPP
+#define IO_POSIX_MAPPED_FILE_CACHE_HPP
+
+#include <io/posix/mmap_file.hpp>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace io {
+namespace posix {
+
+/// A read-only stream over a mapping shared through a `mapped_file_cache`.
+///
+/// Views are cheap to copy; each copy has its own cursor. The mapping stays
+/// valid for as long as any view of it exists, even after it has been evicted
+/// from the cache.
+class mapped_file_view
+    : public io::detail::memory_stream_impl<mapped_file_view, ::off_t> {
+public:
+    using size_type = ::off_t;
+
+    mapped_file_view() = default;
+
+    explicit mapped_file_view(std::shared_ptr<const detail::mmap_handle> mapping) noexcept
+        : mapping_(std::move(mapping))
+    {}
+
+    const void* data() const noexcept
+    {
+        return mapping_ ? mapping_->address() : nullptr;
+    }
+
+    size_type size() const noexcept
+    {
+        return mapping_ ? mapping_->size() : 0;
+    }
+
+private:
+    std::shared_ptr<const detail::mmap_handle> mapping_;
+};
+
+/// A thread-safe cache of read-only file mappings.
+///
+/// Files are identified by device, inode, size and modification time, so
+/// that every path to a file shares one mapping, and a file which has been
+/// modified or replaced is mapped afresh. Opening a file which is already in
+/// the cache costs a single `stat()`.
+///
+/// The least recently used mappings are dropped once the total size of the
+/// cached mappings exceeds the budget. Views which are still in use keep their
+/// mappings alive after eviction, so the budget limits what the cache itself
+/// retains rather than the total mapped by the process.
+class mapped_file_cache {
+public:
+    static constexpr std::size_t default_budget = std::size_t{1} << 30;
+
+    explicit mapped_file_cache(std::size_t budget = default_budget)
+        : budget_(budget)
+    {}
+
+    mapped_file_cache(const mapped_file_cache&) = delete;
+    mapped_file_cache& operator=(const mapped_file_cache&) = delete;
+
+    /// Returns a view of the file at `path`, mapping it if it is not already
+    /// in the cache
+    mapped_file_view open(const io_std::filesystem::path& path, std::error_code& ec)
+    {
+        ec.clear();
+        errno = 0;
+
+        struct ::stat st;
+        if (::stat(path.c_str(), &st) != 0) {
+            ec.assign(errno, std::system_category());
+            return {};
+        }
+
+        if (auto mapping = this->find(make_key(st))) {
+            return mapped_file_view{std::move(mapping)};
+        }
+
+        // Map the file without holding the lock, so that a slow miss does not
+        // hold up hits on other files
+        int raw_fd = ::open(path.c_str(), O_RDONLY);
+        if (raw_fd < 0) {
+            ec.assign(errno, std::system_category());
+            return {};
+        }
+        file_descriptor_handle fd{raw_fd};
+
+        // The file may have been replaced since the stat() above
+        if (::fstat(fd.get(), &st) != 0) {
+            ec.assign(errno, std::system_category());
+            return {};
+        }
+
+        auto handle = detail::mmap_handle::create(fd, st.st_size,
+                                                  open_mode::read_only, ec);
+        if (ec) {
+            return {};
+        }
+
+        auto mapping = std::make_shared<const detail::mmap_handle>(std::move(handle));
+        return mapped_file_view{this->insert(make_key(st), std::move(mapping))};
+    }
+
+    mapped_file_view open(const io_std::filesystem::path& path)
+    {
+        std::error_code ec;
+        auto view = this->open(path, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return view;
+    }
+
+    /// Returns the number of files in the cache
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return entries_.size();
+    }
+
+    /// Returns the total size of the cached mappings, in bytes
+    std::size_t mapped_bytes() const
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return mapped_bytes_;
+    }
+
+    std::size_t budget() const noexcept { return budget_; }
+
+    /// Drops every mapping from the cache
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        entries_.clear();
+        lru_.clear();
+        mapped_bytes_ = 0;
+    }
+
+private:
+    struct key_type {
+        ::dev_t dev;
+        ::ino_t ino;
+        ::off_t size;
+        std::int64_t mtime_sec;
+        long mtime_nsec;
+
+        friend bool operator==(const key_type& lhs, const key_type& rhs) noexcept
+        {
+            return lhs.dev == rhs.dev && lhs.ino == rhs.ino &&
+                   lhs.size == rhs.size && lhs.mtime_sec == rhs.mtime_sec &&
+                   lhs.mtime_nsec == rhs.mtime_nsec;
+        }
+    };
+
+    struct key_hash {
+        std::size_t operator()(const key_type& k) const noexcept
+        {
+            std::size_t h = std::hash<std::uint64_t>{}(k.ino);
+            const auto combine = [&h] (std::uint64_t v) {
+                h ^= std::hash<std::uint64_t>{}(v) + 0x9e3779b97f4a7c15ull +
+                     (h << 6) + (h >> 2);
+            };
+            combine(k.dev);
+            combine(k.size);
+            combine(k.mtime_sec);
+            combine(k.mtime_nsec);
+            return h;
+        }
+    };
+
+    using mapping_ptr = std::shared_ptr<const detail::mmap_handle>;
+    using lru_list = std::list<key_type>;
+
+    struct entry {
+        mapping_ptr mapping;
+        lru_list::iterator lru_pos;
+    };
+
+    static key_type make_key(const struct ::stat& st) noexcept
+    {
+#ifdef __APPLE__
+        const auto& mtime = st.st_mtimespec;
+#else
+        const auto& mtime = st.st_mtim;
+#endif
+        return key_type{st.st_dev, st.st_ino, st.st_size,
+                        static_cast<std::int64_t>(mtime.tv_sec),
+                        static_cast<long>(mtime.tv_nsec)};
+    }
+
+    mapping_ptr find(const key_type& key)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            return nullptr;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+        return it->second.mapping;
+    }
+
+    // Adds a new mapping, unless another thread got there first, in which
+    // case its mapping is returned instead
+    mapping_ptr insert(const key_type& key, mapping_ptr mapping)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+            return it->second.mapping;
+        }
+
+        lru_.push_front(key);
+        entries_.emplace(key, entry{mapping, lru_.begin()});
+        mapped_bytes_ += static_cast<std::size_t>(mapping->size());
+
+        // Evict, but never the entry we have just added
+        while (mapped_bytes_ > budget_ && lru_.size() > 1) {
+            auto victim = entries_.find(lru_.back());
+            mapped_bytes_ -= static_cast<std::size_t>(victim->second.mapping->size());
+            entries_.erase(victim);
+            lru_.pop_back();
+        }
+
+        return mapping;
+    }
+
+    const std::size_t budget_;
+    mutable std::mutex mutex_;
+    std::unordered_map<key_type, entry, key_hash> entries_;
+    lru_list lru_;
+    std::size_t mapped_bytes_ = 0;
+};
+
+} // end namespace posix
+} // end namespace io
+
+#endif // IO_POSIX_MAPPED_FILE_CACHE_HPP
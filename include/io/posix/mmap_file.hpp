@@ -11,40 +11,139 @@
 
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <map>
 
 namespace io {
 namespace posix {
 
+/// Options controlling how a file is mapped into memory
+struct mmap_options {
+    /// Fault in the whole mapping when it is created, rather than one page at
+    /// a time on first access.
+    /// This is equivalent to the Linux flag `MAP_POPULATE`, and is ignored on
+    /// platforms which do not support it
+    bool populate = false;
+
+    /// Back the mapping with transparent huge pages where possible, reducing
+    /// page faults and TLB misses.
+    /// This is equivalent to the Linux advice `MADV_HUGEPAGE`. It is only a
+    /// hint, and is ignored where it is not supported.
+    bool huge_pages = false;
+
+    /// How the mapping is expected to be accessed, given to `madvise()`
+    access_hint hint = access_hint::normal;
+
+    /// Lock the mapping into memory with `mlock()`, so that it cannot be paged
+    /// out. This is subject to the process's `RLIMIT_MEMLOCK` limit.
+    bool lock = false;
+
+    /// Map a private, writable snapshot of the file.
+    /// Writes go to private copies of the pages they touch, and are never
+    /// seen by the file or other mappings of it; untouched pages remain shared
+    /// with the page cache. The file itself is only opened for reading.
+    /// This is equivalent to the Posix flag `MAP_PRIVATE`
+    bool copy_on_write = false;
+};
+
 namespace detail {
 
+// Returns the madvise() advice for `h`, or -1 if there is none. For a private
+// (copy-on-write) mapping, MADV_DONTNEED would discard the modified pages,
+// changing what is read back, so the gentler MADV_COLD is used if available.
+constexpr int access_hint_to_madvise_arg(access_hint h, bool copy_on_write = false)
+{
+    switch (h) {
+    case access_hint::sequential:
+        return MADV_SEQUENTIAL;
+    case access_hint::random:
+        return MADV_RANDOM;
+    case access_hint::willneed:
+        return MADV_WILLNEED;
+    case access_hint::dontneed:
+        if (copy_on_write) {
+#ifdef MADV_COLD
+            return MADV_COLD;
+#else
+            return -1;
+#endif
+        }
+        return MADV_DONTNEED;
+    case access_hint::noreuse: // no madvise() equivalent
+        return -1;
+    case access_hint::normal:
+    default:
+        return MADV_NORMAL;
+    }
+}
+
 struct mmap_handle {
 
+    static int mode_to_prot(io::open_mode mode) noexcept
+    {
+        if ((mode & open_mode::read_only) != open_mode(0)) {
+            return PROT_READ;
+        } else if ((mode & open_mode::write_only) != open_mode(0)) {
+            return PROT_WRITE;
+        } else if ((mode & open_mode::read_write) != open_mode(0)) {
+            return PROT_READ | PROT_WRITE;
+        }
+        return PROT_NONE;
+    }
+
     static mmap_handle create(const file_descriptor_handle& fd, ::off_t size,
                               io::open_mode mode,
+                              const mmap_options& options,
                               std::error_code& ec)
     {
         ec.clear();
 
-        int prot = PROT_NONE;
+        // Zero-length mappings are not allowed
+        if (size == 0) {
+            return mmap_handle{};
+        }
 
-        if ((mode & open_mode::read_only) != open_mode(0)) {
-            prot = PROT_READ;
-        } else if ((mode & open_mode::write_only) != open_mode(0)) {
-            prot = PROT_WRITE;
-        } else if ((mode & open_mode::read_write) != open_mode(0)) {
+        int prot = mode_to_prot(mode);
+        int flags = MAP_FILE | MAP_SHARED;
+        if (options.copy_on_write) {
             prot = PROT_READ | PROT_WRITE;
+            flags = MAP_FILE | MAP_PRIVATE;
         }
+#ifdef MAP_POPULATE
+        // Populating a private writable mapping would copy every page
+        if (options.populate && !options.copy_on_write) {
+            flags |= MAP_POPULATE;
+        }
+#endif
 
-        void* addr = ::mmap(nullptr, size, prot,
-                            MAP_FILE | MAP_SHARED,
-                            fd.get(), 0);
+        void* addr = ::mmap(nullptr, size, prot, flags, fd.get(), 0);
 
         if (addr == MAP_FAILED) {
             ec.assign(errno, std::system_category());
             return mmap_handle{};
         }
 
+        mmap_handle handle(addr, size);
+        handle.apply(options, ec);
+        if (ec) {
+            return mmap_handle{};
+        }
+        return handle;
+    }
+
+    static mmap_handle create(const file_descriptor_handle& fd, ::off_t size,
+                              io::open_mode mode,
+                              std::error_code& ec)
+    {
+        return create(fd, size, mode, mmap_options{}, ec);
+    }
+
+    /// Takes ownership of an existing mapping
+    static mmap_handle adopt(void* addr, ::off_t size) noexcept
+    {
         return mmap_handle(addr, size);
     }
 
@@ -62,14 +161,14 @@ struct mmap_handle {
         }
     }
 
-    mmap_handle(mmap_handle&& other)
+    mmap_handle(mmap_handle&& other) noexcept
             : addr_(other.addr_), size_(other.size_)
     {
         other.addr_ = nullptr;
         other.size_ = 0;
     }
 
-    mmap_handle& operator=(mmap_handle&& other)
+    mmap_handle& operator=(mmap_handle&& other) noexcept
     {
         if (&other != this) {
             std::swap(addr_, other.addr_);
@@ -82,10 +181,45 @@ struct mmap_handle {
 
     ::off_t size() const { return size_; }
 
+    /// Changes the size of the mapping, which may move it in memory
+    void remap(const file_descriptor_handle& fd, ::off_t new_size,
+               io::open_mode mode, const mmap_options& options,
+               std::error_code& ec)
+    {
+        ec.clear();
+        errno = 0;
+
+        if (addr_ == nullptr || new_size == 0) {
+            *this = create(fd, new_size, mode, options, ec);
+            return;
+        }
+
+#ifdef MREMAP_MAYMOVE
+        (void) mode;
+        void* addr = ::mremap(addr_, size_, new_size, MREMAP_MAYMOVE);
+        if (addr == MAP_FAILED) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+        addr_ = addr;
+        size_ = new_size;
+        this->apply(options, ec);
+#else
+        auto new_mmap = create(fd, new_size, mode, options, ec);
+        if (!ec) {
+            // The old mapping is released when new_mmap is destroyed
+            std::swap(*this, new_mmap);
+        }
+#endif
+    }
+
     void unmap(std::error_code& ec)
     {
         ec.clear();
         errno = 0;
+        if (addr_ == nullptr) {
+            return;
+        }
         if (::munmap(addr_, size_) != 0) {
             ec.assign(errno, std::system_category());
         } else {
@@ -99,31 +233,282 @@ private:
     mmap_handle(void* addr, ::off_t size)
             : addr_(addr), size_(size) {}
 
+    // Applies the advice and locking requested by `options`
+    void apply(const mmap_options& options, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+
+        const int advice = access_hint_to_madvise_arg(options.hint,
+                                                      options.copy_on_write);
+        if (options.hint != access_hint::normal && advice != -1) {
+            // Advice is only a hint, so failure is not an error
+            ::madvise(addr_, size_, advice);
+        }
+#ifdef MADV_POPULATE_READ
+        if (options.populate && options.copy_on_write) {
+            ::madvise(addr_, size_, MADV_POPULATE_READ);
+        }
+#endif
+#ifdef MADV_HUGEPAGE
+        if (options.huge_pages) {
+            ::madvise(addr_, size_, MADV_HUGEPAGE);
+        }
+#endif
+        if (options.lock && ::mlock(addr_, size_) != 0) {
+            ec.assign(errno, std::system_category());
+        }
+    }
+
     void* addr_ = nullptr;
     ::off_t size_ = 0;
 };
 
+// Asks the kernel to start reading in the pages of mapped memory covering
+// [first, last). This is only a hint, so errors are ignored.
+inline void will_need(const void* first, const void* last) noexcept
+{
+    static const std::uintptr_t page_size = ::sysconf(_SC_PAGESIZE);
+
+    const auto start = reinterpret_cast<std::uintptr_t>(first) / page_size * page_size;
+    const auto end = reinterpret_cast<std::uintptr_t>(last);
+    if (end > start) {
+        ::madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+    }
+}
+
+/// A set of disjoint byte ranges of a mapping, widened to whole pages, which
+/// have been written since they were last flushed
+class dirty_page_set {
+public:
+    void add(::off_t first, ::off_t last)
+    {
+        static const ::off_t page_size = ::sysconf(_SC_PAGESIZE);
+
+        first -= first % page_size;
+        last = (last + page_size - 1) / page_size * page_size;
+        if (last <= first) {
+            return;
+        }
+
+        // Merge with any ranges which overlap or touch the new one
+        auto it = ranges_.upper_bound(first);
+        if (it != ranges_.begin() && std::prev(it)->second >= first) {
+            --it;
+            first = it->first;
+        }
+        while (it != ranges_.end() && it->first <= last) {
+            last = std::max(last, it->second);
+            it = ranges_.erase(it);
+        }
+        ranges_.emplace(first, last);
+    }
+
+    /// Returns the total number of bytes in the set
+    ::off_t size() const noexcept
+    {
+        ::off_t total = 0;
+        for (const auto& r : ranges_) {
+            total += r.second - r.first;
+        }
+        return total;
+    }
+
+    bool empty() const noexcept { return ranges_.empty(); }
+
+    void clear() noexcept { ranges_.clear(); }
+
+    /// Calls `func(first, last)` for each range in order, removing the range
+    /// from the set if it succeeds. Stops at the first error.
+    template <typename Func>
+    void consume(Func func, std::error_code& ec)
+    {
+        ec.clear();
+        auto it = ranges_.begin();
+        while (it != ranges_.end()) {
+            func(it->first, it->second, ec);
+            if (ec) {
+                return;
+            }
+            it = ranges_.erase(it);
+        }
+    }
+
+private:
+    std::map<::off_t, ::off_t> ranges_; // first -> last
+};
+
+/// An iterator over successive fixed-size chunks of a mapping, each of which
+/// is a `const_buffer`. As it advances, it asks for the pages up to
+/// `read_ahead` bytes beyond the current chunk to be read in, so that they
+/// are already resident by the time they are reached.
+class prefetching_chunk_iterator {
+public:
+    using value_type = io::const_buffer;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = value_type;
+    using iterator_category = std::forward_iterator_tag;
+
+    prefetching_chunk_iterator() = default;
+
+    prefetching_chunk_iterator(const unsigned char* pos, const unsigned char* last,
+                               std::size_t chunk_size, std::size_t read_ahead) noexcept
+        : pos_(pos), last_(last), prefetched_(pos),
+          chunk_size_(chunk_size), read_ahead_(read_ahead)
+    {
+        // A chunk size of zero would never advance
+        assert(chunk_size > 0);
+        this->prefetch();
+    }
+
+    value_type operator*() const noexcept
+    {
+        return io::buffer(pos_, this->current_size());
+    }
+
+    prefetching_chunk_iterator& operator++() noexcept
+    {
+        pos_ += this->current_size();
+        this->prefetch();
+        return *this;
+    }
+
+    prefetching_chunk_iterator operator++(int) noexcept
+    {
+        auto tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    friend bool operator==(const prefetching_chunk_iterator& lhs,
+                           const prefetching_chunk_iterator& rhs) noexcept
+    {
+        return lhs.pos_ == rhs.pos_;
+    }
+
+    friend bool operator!=(const prefetching_chunk_iterator& lhs,
+                           const prefetching_chunk_iterator& rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
+private:
+    std::size_t current_size() const noexcept
+    {
+        return std::min<std::size_t>(chunk_size_, last_ - pos_);
+    }
+
+    // Keeps the prefetched region at least half of the read-ahead distance
+    // ahead of the cursor, so that advice is given in large batches
+    void prefetch() noexcept
+    {
+        if (read_ahead_ == 0) {
+            return;
+        }
+        const auto target = pos_ + std::min<std::size_t>(read_ahead_ + chunk_size_,
+                                                         last_ - pos_);
+        if (target > prefetched_ &&
+            (static_cast<std::size_t>(target - prefetched_) >= read_ahead_ / 2 ||
+             target == last_)) {
+            will_need(std::max(prefetched_, pos_), target);
+            prefetched_ = target;
+        }
+    }
+
+    const unsigned char* pos_ = nullptr;
+    const unsigned char* last_ = nullptr;
+    const unsigned char* prefetched_ = nullptr;
+    std::size_t chunk_size_ = 0;
+    std::size_t read_ahead_ = 0;
+};
+
 } // end namespace detail
 
+/// A file mapped into memory.
+///
+/// A file opened with `open_mode::write_only` or `open_mode::read_write` can
+/// be written through `write_some()`. Writes which pass the end of the file
+/// extend both the file and the mapping, growing them geometrically so that
+/// producing a large output costs few system calls. The file is trimmed back
+/// to the number of bytes actually written by `close()`, or on destruction.
+///
+/// A file mapped with `mmap_options::copy_on_write` is a private snapshot,
+/// which can be patched through `write_some()` without changing the file.
+/// Such a mapping cannot grow, so writes stop at the end of the snapshot.
+///
+/// Written data is made durable with `flush()`. With dirty tracking enabled,
+/// the pages touched by `write_some()` are remembered, so that `flush()` syncs
+/// only those rather than the whole mapping.
 class mmap_file : public io::detail::memory_stream_impl<mmap_file, ::off_t> {
 public:
     using size_type = ::off_t;
 
+    /// The minimum number of bytes by which a writable mapping is extended
+    static constexpr size_type min_growth = 64 * 1024;
+
+    /// A suitable read-ahead distance for sequential scans
+    static constexpr size_type default_read_ahead = 2 * 1024 * 1024;
+
+    /// A range of fixed-size chunks of the mapping; see `chunks()`
+    struct chunk_range {
+        using iterator = detail::prefetching_chunk_iterator;
+
+        iterator begin() const noexcept { return first; }
+        iterator end() const noexcept { return last; }
+
+        iterator first;
+        iterator last;
+    };
+
     mmap_file() = default;
 
+    mmap_file(mmap_file&&) noexcept = default;
+
+    mmap_file& operator=(mmap_file&& other) noexcept
+    {
+        if (&other != this) {
+            std::error_code ec;
+            this->close(ec);
+            memory_stream_impl::operator=(std::move(other));
+            mmap_ = std::move(other.mmap_);
+            fd_ = std::move(other.fd_);
+            mode_ = other.mode_;
+            options_ = other.options_;
+            size_ = other.size_;
+            read_ahead_ = other.read_ahead_;
+            prefetched_ = other.prefetched_;
+            track_dirty_ = other.track_dirty_;
+            grown_ = other.grown_;
+            dirty_ = std::move(other.dirty_);
+        }
+        return *this;
+    }
+
+    /// Closes the file, trimming it to its written size if necessary
+    ~mmap_file()
+    {
+        if (fd_.get() != -1) {
+            std::error_code ec;
+            this->close(ec);
+        }
+    }
+
     mmap_file(const io_std::filesystem::path& path,
               open_mode mode,
-              io_std::filesystem::perms create_perms = default_creation_perms)
+              io_std::filesystem::perms create_perms = default_creation_perms,
+              const mmap_options& options = {})
     {
-        this->open(path, mode, create_perms);
+        this->open(path, mode, create_perms, options);
     }
 
     void open(const io_std::filesystem::path& path,
               open_mode mode,
-              io_std::filesystem::perms create_perms = default_creation_perms)
+              io_std::filesystem::perms create_perms = default_creation_perms,
+              const mmap_options& options = {})
     {
         std::error_code ec;
-        this->open(path, mode, create_perms, ec);
+        this->open(path, mode, create_perms, options, ec);
         if (ec) {
             throw std::system_error{ec};
         }
@@ -134,11 +519,36 @@ public:
               io_std::filesystem::perms create_perms,
               std::error_code& ec) noexcept
     {
-        ec.clear();
+        this->open(path, mode, create_perms, mmap_options{}, ec);
+    }
+
+    /// Opens and maps the file at `path`, using `options` to control how it
+    /// is mapped. The options also apply when a writable mapping grows.
+    void open(const io_std::filesystem::path& path,
+              open_mode mode,
+              io_std::filesystem::perms create_perms,
+              const mmap_options& options,
+              std::error_code& ec) noexcept
+    {
+        this->close(ec);
+        if (ec) {
+            return;
+        }
         errno = 0;
 
+        // A shared mapping needs read access to the file even if it is only
+        // going to be written to, while a private one never writes to it
+        int posix_mode = detail::open_mode_to_posix_mode(mode);
+        const bool writable = (posix_mode & O_ACCMODE) != O_RDONLY &&
+                              !options.copy_on_write;
+        if (writable) {
+            posix_mode = (posix_mode & ~O_ACCMODE) | O_RDWR;
+        } else {
+            posix_mode = (posix_mode & ~O_ACCMODE) | O_RDONLY;
+        }
+
         // First, try to open the file
-        int raw_fd = ::open(path.c_str(), detail::open_mode_to_posix_mode(mode),
+        int raw_fd = ::open(path.c_str(), posix_mode,
                             static_cast<::mode_t>(create_perms));
         if (raw_fd < 0) {
             ec.assign(errno, std::system_category());
@@ -153,12 +563,19 @@ public:
             return;
         }
 
-        auto mmap = detail::mmap_handle::create(new_fd, size, mode, ec);
+        auto mmap = detail::mmap_handle::create(new_fd, size, mode, options, ec);
         if (ec) {
             return;
         }
 
         this->mmap_ = std::move(mmap);
+        this->mode_ = mode;
+        this->options_ = options;
+        this->size_ = size;
+        if (writable) {
+            // Keep the descriptor so that the file can be resized
+            this->fd_ = std::move(new_fd);
+        }
     }
 
     void close()
@@ -173,6 +590,96 @@ public:
     void close(std::error_code& ec)
     {
         mmap_.unmap(ec);
+        if (ec) {
+            return;
+        }
+
+        if (fd_.get() != -1) {
+            errno = 0;
+            // Only trim the space added by grow(). Truncating a file we did
+            // not extend would update its modification time for nothing, and
+            // cut off anything appended to it by another writer.
+            if (grown_ && ::ftruncate(fd_.get(), size_) != 0) {
+                ec.assign(errno, std::system_category());
+            }
+            std::error_code close_ec;
+            fd_.close(close_ec);
+            if (!ec) {
+                ec = close_ec;
+            }
+        }
+
+        size_ = 0;
+        grown_ = false;
+        dirty_.clear();
+        std::error_code ignored;
+        this->seek(0, io::seek_mode::start, ignored);
+    }
+
+    /// Enables read-ahead for sequential scans: as `read_some()` and
+    /// `read_next()` advance the cursor, the kernel is asked to read in the
+    /// pages up to `distance` bytes ahead of it, so that the scan does not
+    /// stall on a page fault at each new page. A distance of zero disables
+    /// read-ahead.
+    void set_read_ahead(size_type distance) noexcept
+    {
+        read_ahead_ = std::max<size_type>(distance, 0);
+        prefetched_ = get_position().offset_from_start();
+        this->prefetch();
+    }
+
+    size_type read_ahead() const noexcept { return read_ahead_; }
+
+    /// Returns a range of `const_buffer`s covering the mapping in chunks of
+    /// `chunk_size` bytes (the last may be shorter), which prefetches
+    /// `read_ahead` bytes ahead of the chunk it is on
+    /// @throws std::system_error if `chunk_size` is zero
+    chunk_range chunks(std::size_t chunk_size,
+                       std::size_t read_ahead = default_read_ahead) const
+    {
+        if (chunk_size == 0) {
+            throw std::system_error{std::make_error_code(std::errc::invalid_argument)};
+        }
+        return chunk_range{
+            detail::prefetching_chunk_iterator{begin(), end(), chunk_size, read_ahead},
+            detail::prefetching_chunk_iterator{end(), end(), chunk_size, 0}
+        };
+    }
+
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb)
+    {
+        std::error_code ec;
+        auto bytes_read = this->read_some(mb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return bytes_read;
+    }
+
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb, std::error_code& ec) noexcept
+    {
+        auto bytes_read = memory_stream_impl::read_some(mb, ec);
+        this->prefetch();
+        return bytes_read;
+    }
+
+    unsigned char read_next()
+    {
+        std::error_code ec;
+        const auto opt = this->read_next(ec);
+        if (!opt) {
+            throw std::system_error{ec};
+        }
+        return *opt;
+    }
+
+    io_std::optional<unsigned char> read_next(std::error_code& ec)
+    {
+        auto opt = memory_stream_impl::read_next(ec);
+        this->prefetch();
+        return opt;
     }
 
     template <typename ConstBufSeq>
@@ -195,24 +702,228 @@ public:
         ec.clear();
         errno = 0;
 
-        auto buf = io::buffer(data(), size()) + get_position().offset_from_start();
+        if (fd_.get() == -1 && !options_.copy_on_write) {
+            ec = std::make_error_code(std::errc::bad_file_descriptor);
+            return 0;
+        }
+
+        const size_type pos = get_position().offset_from_start();
+        const auto end = pos + static_cast<size_type>(io::buffer_size(cb));
+        if (end > capacity()) {
+            if (options_.copy_on_write) {
+                // Private snapshots have a fixed size
+                if (pos == capacity()) {
+                    ec = std::make_error_code(std::errc::file_too_large);
+                    return 0;
+                }
+            } else {
+                this->grow(end, ec);
+                if (ec) {
+                    return 0;
+                }
+            }
+        }
+
+        auto buf = io::buffer(data(), capacity()) + pos;
 
         auto total_bytes_written = io::buffer_copy(buf, cb);
+        size_ = std::max(size_, pos + static_cast<size_type>(total_bytes_written));
+        if (track_dirty_) {
+            dirty_.add(pos, pos + static_cast<size_type>(total_bytes_written));
+        }
         this->seek(total_bytes_written, io::seek_mode::current, ec);
 
         return total_bytes_written;
     }
 
+    /// Advises the operating system how the byte range `[offset, offset + len)`
+    /// of the mapping will be accessed. The range is widened to whole pages.
+    /// A `len` of zero extends the range to the end of the mapping.
+    void advise(offset_type offset, offset_type len, access_hint hint,
+                std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+
+        if (offset < 0 || offset > size() || len < 0) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return;
+        }
+
+        const offset_type page_size = ::sysconf(_SC_PAGESIZE);
+        const offset_type start = offset - offset % page_size;
+        const offset_type end = (len == 0) ? size() : std::min(offset + len, size());
+
+        const int advice = detail::access_hint_to_madvise_arg(
+                hint, options_.copy_on_write);
+        if (end <= start || advice == -1) {
+            return;
+        }
+
+        if (::madvise(static_cast<char*>(data()) + start, end - start,
+                      advice) != 0) {
+            ec.assign(errno, std::system_category());
+        }
+    }
+
+    void advise(offset_type offset, offset_type len, access_hint hint)
+    {
+        std::error_code ec;
+        this->advise(offset, len, hint, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Writes the byte range `[offset, offset + len)` of the mapping back to
+    /// the file, widened to whole pages. A `len` of zero extends the range to
+    /// the end of the mapping. If `async` is true, the write-back is only
+    /// scheduled, and this does not wait for it to complete.
+    void flush(offset_type offset, offset_type len, bool async,
+               std::error_code& ec) noexcept
+    {
+        ec.clear();
+
+        if (offset < 0 || offset > capacity() || len < 0) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return;
+        }
+
+        const offset_type end = (len == 0) ? capacity()
+                                           : std::min(offset + len, capacity());
+        this->sync_pages(offset, end, async, ec);
+    }
+
+    void flush(offset_type offset, offset_type len, bool async = false)
+    {
+        std::error_code ec;
+        this->flush(offset, len, async, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Writes the mapping back to the file. With dirty tracking enabled, only
+    /// the pages written since the last flush are synced.
+    /// Flushing a copy-on-write mapping has no effect.
+    void flush(bool async, std::error_code& ec) noexcept
+    {
+        if (!track_dirty_) {
+            this->sync_pages(0, capacity(), async, ec);
+            return;
+        }
+
+        dirty_.consume([this, async] (offset_type first, offset_type last,
+                                      std::error_code& ec) {
+            this->sync_pages(first, std::min(last, capacity()), async, ec);
+        }, ec);
+    }
+
+    void flush(bool async = false)
+    {
+        std::error_code ec;
+        this->flush(async, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Enables or disables tracking of the pages written by `write_some()`.
+    /// Disabling it forgets any pages which are still unflushed.
+    void set_dirty_tracking(bool enable) noexcept
+    {
+        track_dirty_ = enable;
+        if (!enable) {
+            dirty_.clear();
+        }
+    }
+
+    bool dirty_tracking() const noexcept { return track_dirty_; }
+
+    /// Returns the number of bytes of written pages which are still to be
+    /// flushed, when dirty tracking is enabled
+    size_type dirty_size() const noexcept { return dirty_.size(); }
+
     void* data() const noexcept { return mmap_.address(); }
 
-    size_type size() const noexcept { return mmap_.size(); }
+    /// Returns the size of the file, in bytes
+    size_type size() const noexcept { return size_; }
+
+    /// Returns the size of the mapping, which may be larger than the file
+    /// while it is being written
+    size_type capacity() const noexcept { return mmap_.size(); }
 
 private:
     mmap_file(detail::mmap_handle mmap)
-            : mmap_(std::move(mmap))
+            : mmap_(std::move(mmap)),
+              size_(mmap_.size())
     {}
 
+    // Called after each read, so must be cheap when there is nothing to do
+    void prefetch() noexcept
+    {
+        if (read_ahead_ == 0) {
+            return;
+        }
+
+        const auto pos = get_position().offset_from_start();
+        if (prefetched_ - pos >= read_ahead_ / 2 || prefetched_ == size()) {
+            return;
+        }
+
+        const auto first = std::max(prefetched_, pos);
+        const auto last = std::min(pos + read_ahead_, size());
+        const auto base = static_cast<const unsigned char*>(data());
+        detail::will_need(base + first, base + last);
+        prefetched_ = last;
+    }
+
+    // Syncs the pages covering [first, last) of the mapping
+    void sync_pages(offset_type first, offset_type last, bool async,
+                    std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+
+        const offset_type page_size = ::sysconf(_SC_PAGESIZE);
+        first -= first % page_size;
+        if (data() == nullptr || last <= first || options_.copy_on_write) {
+            return;
+        }
+
+        if (::msync(static_cast<char*>(data()) + first, last - first,
+                    async ? MS_ASYNC : MS_SYNC) != 0) {
+            ec.assign(errno, std::system_category());
+        }
+    }
+
+    void grow(size_type min_capacity, std::error_code& ec)
+    {
+        const size_type page_size = ::sysconf(_SC_PAGESIZE);
+        size_type new_capacity = std::max({min_capacity, 2 * capacity(), min_growth});
+        new_capacity = (new_capacity + page_size - 1) / page_size * page_size;
+
+        errno = 0;
+        if (::ftruncate(fd_.get(), new_capacity) != 0) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+        grown_ = true;
+
+        mmap_.remap(fd_, new_capacity, mode_, options_, ec);
+    }
+
     detail::mmap_handle mmap_{};
+    file_descriptor_handle fd_{};
+    open_mode mode_{};
+    mmap_options options_{};
+    size_type size_ = 0;
+    size_type read_ahead_ = 0;
+    size_type prefetched_ = 0;
+    bool track_dirty_ = false;
+    // Whether the file has been extended beyond its written size
+    bool grown_ = false;
+    detail::dirty_page_set dirty_{};
 };
 
 } // namespace posix
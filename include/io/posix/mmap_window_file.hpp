@@ -0,0 +1,328 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_POSIX_MMAP_WINDOW_FILE_HPP
+#define IO_POSIX_MMAP_WINDOW_FILE_HPP
+
+#include <io/posix/mmap_file.hpp>
+
+namespace io {
+namespace posix {
+
+/// A read-only file which is mapped into memory one window at a time.
+///
+/// Rather than mapping the whole file, only the aligned window of
+/// `window_size()` bytes containing the stream cursor is mapped, and it is
+/// replaced as reads and seeks move the cursor. This allows files of any size
+/// to be scanned at memory-mapped speed using a bounded amount of address
+/// space.
+///
+/// `begin()` and `end()` give pointer access to the whole of the window
+/// containing the cursor; `next_window()` moves on to the following one.
+class mmap_window_file {
+public:
+    using offset_type = ::off_t;
+    using position_type = io::stream_position<offset_type>;
+    using size_type = offset_type;
+    using value_type = unsigned char;
+    using const_pointer = const value_type*;
+    using iterator = const_pointer;
+    using const_iterator = const_pointer;
+
+    static constexpr size_type default_window_size = 64 * 1024 * 1024;
+
+    mmap_window_file() = default;
+
+    explicit mmap_window_file(const io_std::filesystem::path& path,
+                              size_type window_size = default_window_size)
+    {
+        this->open(path, window_size);
+    }
+
+    void open(const io_std::filesystem::path& path,
+              size_type window_size = default_window_size)
+    {
+        std::error_code ec;
+        this->open(path, window_size, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Opens the file at `path` for reading, using windows of `window_size`
+    /// bytes, rounded up to a whole number of pages
+    void open(const io_std::filesystem::path& path, size_type window_size,
+              std::error_code& ec) noexcept
+    {
+        this->close(ec);
+        if (ec) {
+            return;
+        }
+        errno = 0;
+
+        if (window_size <= 0) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return;
+        }
+
+        int raw_fd = ::open(path.c_str(), O_RDONLY);
+        if (raw_fd < 0) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+        file_descriptor_handle new_fd{raw_fd};
+
+        const offset_type size = ::lseek(new_fd.get(), 0, SEEK_END);
+        if (size == -1) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+
+        const size_type page_size = ::sysconf(_SC_PAGESIZE);
+        fd_ = std::move(new_fd);
+        size_ = size;
+        window_size_ = (window_size + page_size - 1) / page_size * page_size;
+        pos_ = 0;
+    }
+
+    void close()
+    {
+        std::error_code ec;
+        this->close(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    void close(std::error_code& ec) noexcept
+    {
+        window_.unmap(ec);
+        if (ec) {
+            return;
+        }
+        window_offset_ = 0;
+        size_ = 0;
+        pos_ = 0;
+        if (fd_.get() != -1) {
+            fd_.close(ec);
+        }
+    }
+
+    bool is_open() const noexcept { return fd_.get() != -1; }
+
+    /// Returns the size of the file, in bytes
+    size_type size() const noexcept { return size_; }
+
+    size_type window_size() const noexcept { return window_size_; }
+
+    /* SyncReadStream implementation */
+
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb)
+    {
+        std::error_code ec;
+        auto bytes_read = this->read_some(mb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return bytes_read;
+    }
+
+    /// Reads from the window containing the cursor. A read which crosses the
+    /// end of the window is short, and the next read maps the next window.
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb, std::error_code& ec) noexcept
+    {
+        static_assert(io::is_mutable_buffer_sequence_v<MutBufSeq>,
+                      "Argument passed to read_some() is not a MutableBufferSequence");
+
+        ec.clear();
+
+        if (pos_ == size_) {
+            ec = stream_errc::eof;
+            return 0;
+        }
+
+        if (!this->map_window(ec)) {
+            return 0;
+        }
+
+        const auto bytes_copied = io::buffer_copy(
+                mb, io::buffer(window_.address(), window_.size()) + (pos_ - window_offset_));
+        pos_ += bytes_copied;
+        return bytes_copied;
+    }
+
+    unsigned char read_next()
+    {
+        std::error_code ec;
+        const auto opt = this->read_next(ec);
+        if (!opt) {
+            throw std::system_error{ec};
+        }
+        return *opt;
+    }
+
+    io_std::optional<unsigned char> read_next(std::error_code& ec) noexcept
+    {
+        auto opt = this->peek_next(ec);
+        if (opt) {
+            ++pos_;
+        }
+        return opt;
+    }
+
+    unsigned char peek_next()
+    {
+        std::error_code ec;
+        const auto opt = this->peek_next(ec);
+        if (!opt) {
+            throw std::system_error{ec};
+        }
+        return *opt;
+    }
+
+    io_std::optional<unsigned char> peek_next(std::error_code& ec) noexcept
+    {
+        ec.clear();
+        if (pos_ == size_) {
+            ec = stream_errc::eof;
+            return io_std::nullopt;
+        }
+        if (!this->map_window(ec)) {
+            return io_std::nullopt;
+        }
+        return this->begin()[pos_ - window_offset_];
+    }
+
+    /* SeekableStream implementation */
+
+    position_type seek(offset_type offset, seek_mode from)
+    {
+        std::error_code ec;
+        auto pos = this->seek(offset, from, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return pos;
+    }
+
+    /// Moves the cursor. The window is not remapped until it is next needed.
+    position_type seek(offset_type offset, seek_mode from,
+                       std::error_code& ec) noexcept
+    {
+        ec.clear();
+
+        offset_type new_pos = offset;
+        switch (from) {
+        case seek_mode::start:
+            break;
+        case seek_mode::current:
+            new_pos += pos_;
+            break;
+        case seek_mode::end:
+            new_pos += size_;
+            break;
+        }
+
+        if (new_pos < 0 || new_pos > size_) {
+            ec = std::make_error_code(std::errc::invalid_seek);
+        } else {
+            pos_ = new_pos;
+        }
+
+        return position_type{pos_};
+    }
+
+    position_type get_position() const noexcept { return position_type{pos_}; }
+
+    /* Window access */
+
+    /// Returns the offset within the file of the start of the current window
+    offset_type window_offset() const noexcept { return window_offset_; }
+
+    /// Maps the window containing the cursor, if it is not already mapped.
+    /// @returns false if the cursor is at the end of the file, or on error
+    bool map_window(std::error_code& ec) noexcept
+    {
+        ec.clear();
+
+        if (pos_ == size_) {
+            return false;
+        }
+
+        if (window_.address() != nullptr &&
+            pos_ >= window_offset_ && pos_ < window_offset_ + window_.size()) {
+            return true;
+        }
+
+        const offset_type offset = pos_ - pos_ % window_size_;
+        const size_type length = std::min(window_size_, size_ - offset);
+
+        errno = 0;
+        void* addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd_.get(), offset);
+        if (addr == MAP_FAILED) {
+            ec.assign(errno, std::system_category());
+            return false;
+        }
+
+        window_ = detail::mmap_handle::adopt(addr, length);
+        window_offset_ = offset;
+        return true;
+    }
+
+    /// Moves the cursor to the start of the window after the current one,
+    /// and maps it.
+    /// @returns false if there are no more windows
+    bool next_window(std::error_code& ec) noexcept
+    {
+        ec.clear();
+        if (window_.address() == nullptr && !this->map_window(ec)) {
+            return false;
+        }
+        pos_ = std::min(window_offset_ + window_.size(), size_);
+        return this->map_window(ec);
+    }
+
+    bool next_window()
+    {
+        std::error_code ec;
+        const bool result = this->next_window(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return result;
+    }
+
+    /// Returns an iterator to the start of the current window
+    const_iterator begin() const noexcept
+    {
+        return static_cast<const_iterator>(window_.address());
+    }
+
+    /// Returns an iterator to the end of the current window
+    const_iterator end() const noexcept
+    {
+        return this->begin() + window_.size();
+    }
+
+private:
+    file_descriptor_handle fd_{};
+    detail::mmap_handle window_{};
+    offset_type window_offset_ = 0;
+    size_type window_size_ = default_window_size;
+    size_type size_ = 0;
+    offset_type pos_ = 0;
+};
+
+static_assert(is_sync_read_stream_v<mmap_window_file>,
+              "mmap_window_file does not meet the SyncReadStream requirements");
+static_assert(is_seekable_stream_v<mmap_window_file>,
+              "mmap_window_file does not meet the SeekableStream requirements");
+
+} // end namespace posix
+} // end namespace io
+
+#endif // IO_POSIX_MMAP_WINDOW_FILE_HPP
@@ -0,0 +1,274 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_POSIX_RING_BUFFER_STORAGE_HPP
+#define IO_POSIX_RING_BUFFER_STORAGE_HPP
+
+#include <io/buffer.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace io {
+namespace posix {
+
+namespace detail {
+
+// Creates a shared memory object of `size` bytes with no name in the
+// filesystem, returning its descriptor
+inline int create_anonymous_shm(std::size_t size, std::error_code& ec) noexcept
+{
+    ec.clear();
+    errno = 0;
+
+#ifdef MFD_CLOEXEC
+    int fd = ::memfd_create("io-ring-buffer", MFD_CLOEXEC);
+#else
+    static std::atomic<unsigned> counter{0};
+    const std::string name = "/io-ring-buffer-" + std::to_string(::getpid()) +
+                             "-" + std::to_string(counter++);
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        ::shm_unlink(name.c_str());
+    }
+#endif
+    if (fd < 0) {
+        ec.assign(errno, std::system_category());
+        return -1;
+    }
+
+    if (::ftruncate(fd, static_cast<::off_t>(size)) != 0) {
+        ec.assign(errno, std::system_category());
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // end namespace detail
+
+/// Storage for `buffered_read_stream` and `buffered_write_stream` which
+/// never moves its data.
+///
+/// The storage is a ring buffer whose pages are mapped twice in succession,
+/// so that data which wraps around the end of the ring is still contiguous
+/// in memory. Consuming data from the front simply advances the start of the
+/// ring, and there is always contiguous space after the data for the next
+/// read, so the compaction which the default storage performs under steady
+/// partial consumption is never needed.
+///
+/// The capacity is rounded up to a whole number of pages. The memory comes
+/// directly from `mmap()`, so the allocator is unused.
+class ring_buffer_storage {
+public:
+    using byte_type = unsigned char;
+    using size_type = std::size_t;
+
+    static constexpr size_type alignment = 1;
+
+    explicit ring_buffer_storage(size_type max_size)
+    {
+        std::error_code ec;
+        this->map(max_size, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    template <typename Allocator>
+    ring_buffer_storage(size_type max_size, const Allocator&)
+        : ring_buffer_storage(max_size)
+    {}
+
+    ring_buffer_storage(ring_buffer_storage&& other) noexcept
+        : base_(std::exchange(other.base_, nullptr)),
+          capacity_(std::exchange(other.capacity_, 0)),
+          begin_(std::exchange(other.begin_, 0)),
+          end_(std::exchange(other.end_, 0)),
+          history_(std::exchange(other.history_, 0))
+    {}
+
+    ring_buffer_storage& operator=(ring_buffer_storage&& other) noexcept
+    {
+        std::swap(base_, other.base_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(begin_, other.begin_);
+        std::swap(end_, other.end_);
+        std::swap(history_, other.history_);
+        return *this;
+    }
+
+    ~ring_buffer_storage()
+    {
+        if (base_ != nullptr) {
+#if NDEBUG
+            ::munmap(base_, 2 * capacity_);
+#else // !NDEBUG
+            int ret = ::munmap(base_, 2 * capacity_);
+            assert(ret == 0);
+#endif // NDEBUG
+        }
+    }
+
+    void clear()
+    {
+        begin_ = 0;
+        end_ = 0;
+        history_ = 0;
+    }
+
+    mutable_buffer data()
+    {
+        return io::buffer(base_ + begin_, capacity_);
+    }
+
+    const_buffer data() const
+    {
+        return io::buffer(base_ + begin_, capacity_);
+    }
+
+    bool empty() const
+    {
+        return begin_ == end_;
+    }
+
+    size_type size() const
+    {
+        return end_ - begin_;
+    }
+
+    void resize(size_type length)
+    {
+        assert(length <= capacity());
+        end_ = begin_ + length;
+    }
+
+    size_type capacity() const
+    {
+        return capacity_;
+    }
+
+    /// Increases the capacity to at least `new_capacity`, keeping any stored
+    /// data. Buffers previously returned by `data()` and `prepare()` are
+    /// invalidated.
+    void grow(size_type new_capacity)
+    {
+        if (new_capacity <= capacity()) {
+            return;
+        }
+        ring_buffer_storage other{new_capacity};
+        std::memcpy(other.base_, base_ + begin_, this->size());
+        other.end_ = this->size();
+        *this = std::move(other);
+    }
+
+    /// Returns all of the free space following the stored data
+    mutable_buffer prepare()
+    {
+        return io::buffer(base_ + end_, capacity_ - this->size());
+    }
+
+    void commit(size_type count)
+    {
+        assert(this->size() + count <= capacity());
+        end_ += count;
+        // The new data overwrites the oldest consumed bytes
+        history_ = std::min(history_, capacity_ - this->size());
+    }
+
+    /// Removes `count` bytes from the front of the stored data. They remain
+    /// in the ring until they are overwritten, and can be restored by
+    /// `rewind()`.
+    void consume(size_type count)
+    {
+        assert(begin_ + count <= end_);
+        begin_ += count;
+        history_ += count;
+        if (begin_ >= capacity_) {
+            begin_ -= capacity_;
+            end_ -= capacity_;
+        }
+    }
+
+    /// Returns the number of consumed bytes which can be restored by `rewind()`
+    size_type rewindable() const
+    {
+        return history_;
+    }
+
+    /// Restores the last `count` consumed bytes to the front of the stored data
+    void rewind(size_type count)
+    {
+        assert(count <= history_);
+        // Move to the second view if the bytes are at the end of the first
+        if (count > begin_) {
+            begin_ += capacity_;
+            end_ += capacity_;
+        }
+        begin_ -= count;
+        history_ -= count;
+    }
+
+    byte_type front() const { return base_[begin_]; }
+
+private:
+    void map(size_type size, std::error_code& ec)
+    {
+        const size_type page_size = ::sysconf(_SC_PAGESIZE);
+        size = std::max<size_type>((size + page_size - 1) / page_size * page_size,
+                                   page_size);
+
+        const int fd = detail::create_anonymous_shm(size, ec);
+        if (ec) {
+            return;
+        }
+
+        // Reserve enough address space for both views, then map the same
+        // pages into each half
+        void* addr = ::mmap(nullptr, 2 * size, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            ec.assign(errno, std::system_category());
+            ::close(fd);
+            return;
+        }
+
+        auto* base = static_cast<byte_type*>(addr);
+        for (byte_type* half : {base, base + size}) {
+            if (::mmap(half, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                ec.assign(errno, std::system_category());
+                ::munmap(addr, 2 * size);
+                ::close(fd);
+                return;
+            }
+        }
+
+        // The mappings keep the memory alive
+        ::close(fd);
+        base_ = base;
+        capacity_ = size;
+    }
+
+    byte_type* base_ = nullptr;
+    size_type capacity_ = 0;
+    size_type begin_ = 0;
+    size_type end_ = 0;
+    size_type history_ = 0;
+};
+
+} // end namespace posix
+} // end namespace io
+
+#endif // IO_POSIX_RING_BUFFER_STORAGE_HPP
@@ -0,0 +1,117 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_POSIX_SCATTER_GATHER_HPP
+#define IO_POSIX_SCATTER_GATHER_HPP
+
+#include <io/buffer.hpp>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <climits>
+
+namespace io {
+namespace posix {
+namespace detail {
+
+/// The maximum number of iovecs passed to a single vectored system call
+#ifdef IOV_MAX
+constexpr int max_iovecs = std::min(IOV_MAX, 1024);
+#else
+constexpr int max_iovecs = 16; // _XOPEN_IOV_MAX, the Posix minimum
+#endif
+
+/// Fills at most `max` iovecs from the buffers in `[it, last)`, advancing `it`
+/// past the buffers which were used. Empty buffers are skipped, and buffers
+/// which are contiguous in memory are merged into a single iovec.
+/// @returns The number of iovecs filled
+template <typename Iterator>
+int gather_iovecs(Iterator& it, Iterator last, ::iovec* iovs, int max) noexcept
+{
+    int count = 0;
+
+    for (; it != last; ++it) {
+        void* data = const_cast<void*>(static_cast<const void*>(it->data()));
+        const std::size_t size = it->size();
+
+        if (size == 0) {
+            continue;
+        }
+
+        if (count > 0) {
+            ::iovec& prev = iovs[count - 1];
+            if (static_cast<char*>(prev.iov_base) + prev.iov_len == data) {
+                prev.iov_len += size;
+                continue;
+            }
+        }
+
+        if (count == max) {
+            break;
+        }
+
+        iovs[count].iov_base = data;
+        iovs[count].iov_len = size;
+        ++count;
+    }
+
+    return count;
+}
+
+/// Performs a scatter/gather transfer of an arbitrarily long buffer sequence
+/// in chunks of at most `max_iovecs` buffers.
+///
+/// `transfer(iovs, count, bytes_so_far)` performs a single vectored system
+/// call, returning its result. If `all_chunks` is true, successive chunks are
+/// transferred for as long as each one is transferred completely; otherwise
+/// only the first chunk is attempted, which is appropriate for descriptors
+/// such as pipes where a further call could block.
+///
+/// @returns The total number of bytes transferred, or the (negative) result
+/// of the first transfer if it failed, in which case `errno` is set. A failure
+/// after some data has been transferred is not reported, as the next call
+/// will encounter it again.
+template <typename BufSeq, typename Transfer>
+::ssize_t transfer_buffer_sequence(const BufSeq& buffers, bool all_chunks,
+                                   Transfer transfer)
+{
+    ::iovec iovs[max_iovecs];
+    auto it = io::buffer_sequence_begin(buffers);
+    const auto last = io::buffer_sequence_end(buffers);
+    std::size_t total = 0;
+
+    while (it != last) {
+        const int count = gather_iovecs(it, last, iovs, max_iovecs);
+        if (count == 0) {
+            break;
+        }
+
+        std::size_t chunk_size = 0;
+        for (int i = 0; i < count; i++) {
+            chunk_size += iovs[i].iov_len;
+        }
+
+        const ::ssize_t result = transfer(iovs, count, total);
+        if (result < 0) {
+            return total > 0 ? static_cast<::ssize_t>(total) : result;
+        }
+
+        total += static_cast<std::size_t>(result);
+
+        if (!all_chunks || static_cast<std::size_t>(result) < chunk_size) {
+            break;
+        }
+    }
+
+    return static_cast<::ssize_t>(total);
+}
+
+} // end namespace detail
+} // end namespace posix
+} // end namespace io
+
+#endif // IO_POSIX_SCATTER_GATHER_HPP
@@ -0,0 +1,781 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_POSIX_URING_FILE_HPP
+#define IO_POSIX_URING_FILE_HPP
+
+#ifndef __linux__
+#error "io_uring support is only available on Linux"
+#endif
+
+#include <io/posix/file.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <cstring>
+#include <iterator>
+
+namespace io {
+namespace posix {
+
+/// A Linux io_uring submission/completion queue pair.
+///
+/// Operations are queued on the submission ring without making a system call,
+/// and are handed to the kernel in batches by `submit()`. Each queued
+/// operation is tracked by a caller-owned `uring::operation`, which must
+/// remain alive (and at the same address) until it has completed.
+///
+/// A single ring may be shared by any number of `uring_file`s, but it is not
+/// thread-safe: all operations on a ring must happen on one thread at a time.
+class uring {
+public:
+    /// Completion state of a single queued operation
+    struct operation {
+        /// The result of the operation: the number of bytes transferred, or
+        /// a negated `errno` value on failure
+        int result = 0;
+        /// Whether the kernel has completed the operation
+        bool complete = false;
+    };
+
+    static constexpr unsigned default_entries = 256;
+
+    /// Creates a ring with `default_entries` submission queue entries
+    uring() : uring(default_entries) {}
+
+    /// Creates a ring with (at least) `entries` submission queue entries
+    /// @throws std::system_error if the ring could not be set up
+    explicit uring(unsigned entries)
+    {
+        std::error_code ec;
+        this->setup(entries, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    /// Creates a ring with (at least) `entries` submission queue entries
+    uring(unsigned entries, std::error_code& ec) noexcept
+    {
+        this->setup(entries, ec);
+    }
+
+    uring(const uring&) = delete;
+    uring& operator=(const uring&) = delete;
+
+    ~uring()
+    {
+        if (sqes_ != nullptr) {
+            ::munmap(sqes_, sqes_size_);
+        }
+        if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_ != nullptr) {
+            ::munmap(sq_ring_, sq_ring_size_);
+        }
+    }
+
+    /// Returns whether the ring was successfully set up
+    bool is_open() const noexcept { return sqes_ != nullptr; }
+
+    /// Returns the file descriptor of the ring
+    int native_handle() const noexcept { return fd_.get(); }
+
+    /// Returns the number of submission queue entries
+    unsigned entries() const noexcept { return sq_entries_; }
+
+    /// Returns the number of operations which have been queued but not yet
+    /// submitted to the kernel
+    unsigned pending() const noexcept { return to_submit_; }
+
+    /// Returns the number of operations which have been queued but have not
+    /// yet been reaped
+    unsigned in_flight() const noexcept { return in_flight_; }
+
+    /// Queues a vectored read of `fd` at `offset`. An offset of -1 reads
+    /// from (and advances) the current file position.
+    /// If the submission queue is full, the queued operations are first
+    /// submitted to the kernel.
+    void queue_readv(int fd, const ::iovec* iov, unsigned iovcnt,
+                     ::off_t offset, operation& op, std::error_code& ec) noexcept
+    {
+        this->queue(IORING_OP_READV, fd, iov, iovcnt, offset, op, ec);
+    }
+
+    /// Queues a vectored write to `fd` at `offset`. An offset of -1 writes
+    /// at (and advances) the current file position.
+    /// If the submission queue is full, the queued operations are first
+    /// submitted to the kernel.
+    void queue_writev(int fd, const ::iovec* iov, unsigned iovcnt,
+                      ::off_t offset, operation& op, std::error_code& ec) noexcept
+    {
+        this->queue(IORING_OP_WRITEV, fd, iov, iovcnt, offset, op, ec);
+    }
+
+    /// Queues a single-buffer read of `fd` at `offset`
+    void queue_read(int fd, const io::mutable_buffer& mb, ::off_t offset,
+                    operation& op, std::error_code& ec) noexcept
+    {
+        this->queue(IORING_OP_READ, fd, mb.data(), mb.size(), offset, op, ec);
+    }
+
+    /// Queues a single-buffer write to `fd` at `offset`
+    void queue_write(int fd, const io::const_buffer& cb, ::off_t offset,
+                     operation& op, std::error_code& ec) noexcept
+    {
+        this->queue(IORING_OP_WRITE, fd, cb.data(), cb.size(), offset, op, ec);
+    }
+
+    /// Submits all queued operations to the kernel with a single system call,
+    /// without waiting for any of them to complete
+    /// @returns The number of operations submitted
+    unsigned submit(std::error_code& ec) noexcept
+    {
+        return this->enter(0, ec);
+    }
+
+    /// Submits all queued operations to the kernel and waits until at least
+    /// `wait_nr` completions are available, using a single system call
+    /// @returns The number of operations submitted
+    unsigned submit_and_wait(unsigned wait_nr, std::error_code& ec) noexcept
+    {
+        return this->enter(wait_nr, ec);
+    }
+
+    /// Marks every operation on the completion queue as complete, without
+    /// making a system call
+    /// @returns The number of completions reaped
+    unsigned reap() noexcept
+    {
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+
+        while (head != tail) {
+            const ::io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+            auto* op = reinterpret_cast<operation*>(
+                    static_cast<std::uintptr_t>(cqe.user_data));
+            op->result = cqe.res;
+            op->complete = true;
+            ++head;
+            ++count;
+        }
+
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        in_flight_ -= count;
+        return count;
+    }
+
+    /// Submits any queued operations and blocks until `op` has completed.
+    ///
+    /// This never returns while `op` is still in flight. If waiting fails,
+    /// the kernel is asked to cancel `op`, the failure is stored in `ec`, and
+    /// waiting continues until the operation has completed (or been
+    /// cancelled), as reported by its `result`.
+    void wait(operation& op, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        this->reap();
+        bool cancelled = false;
+        while (!op.complete) {
+            std::error_code enter_ec;
+            this->submit_and_wait(1, enter_ec);
+            if (enter_ec && !cancelled) {
+                ec = enter_ec;
+                this->cancel(op);
+                cancelled = true;
+            }
+            this->reap();
+        }
+    }
+
+private:
+    static int sys_setup(unsigned entries, ::io_uring_params* params) noexcept
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    static int sys_enter(int fd, unsigned to_submit, unsigned min_complete,
+                         unsigned flags) noexcept
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                          min_complete, flags, nullptr, 0));
+    }
+
+    static void* map_ring(int fd, std::size_t size, ::off_t offset,
+                          std::error_code& ec) noexcept
+    {
+        void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, offset);
+        if (addr == MAP_FAILED) {
+            ec.assign(errno, std::system_category());
+            return nullptr;
+        }
+        return addr;
+    }
+
+    template <typename T>
+    static T* ring_ptr(void* base, unsigned offset) noexcept
+    {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    void setup(unsigned entries, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+
+        ::io_uring_params params{};
+        int ring_fd = sys_setup(entries, &params);
+        if (ring_fd < 0) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+        fd_ = file_descriptor_handle{ring_fd};
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ = map_ring(ring_fd, sq_ring_size_, IORING_OFF_SQ_RING, ec);
+        if (ec) {
+            return;
+        }
+
+        if (single_mmap) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = map_ring(ring_fd, cq_ring_size_, IORING_OFF_CQ_RING, ec);
+            if (ec) {
+                return;
+            }
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(::io_uring_sqe);
+        void* sqes = map_ring(ring_fd, sqes_size_, IORING_OFF_SQES, ec);
+        if (ec) {
+            return;
+        }
+        sqes_ = static_cast<::io_uring_sqe*>(sqes);
+
+        sq_head_ = ring_ptr<unsigned>(sq_ring_, params.sq_off.head);
+        sq_tail_ = ring_ptr<unsigned>(sq_ring_, params.sq_off.tail);
+        sq_mask_ = ring_ptr<unsigned>(sq_ring_, params.sq_off.ring_mask);
+        sq_array_ = ring_ptr<unsigned>(sq_ring_, params.sq_off.array);
+        cq_head_ = ring_ptr<unsigned>(cq_ring_, params.cq_off.head);
+        cq_tail_ = ring_ptr<unsigned>(cq_ring_, params.cq_off.tail);
+        cq_mask_ = ring_ptr<unsigned>(cq_ring_, params.cq_off.ring_mask);
+        cqes_ = ring_ptr<::io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+        sq_entries_ = params.sq_entries;
+        cq_entries_ = params.cq_entries;
+    }
+
+    void queue(std::uint8_t opcode, int fd, const void* addr, std::size_t len,
+               ::off_t offset, operation& op, std::error_code& ec) noexcept
+    {
+        ec.clear();
+
+        // Never allow more operations in flight than the completion queue can
+        // hold, otherwise completions could be dropped
+        while (in_flight_ >= cq_entries_) {
+            this->submit_and_wait(1, ec);
+            if (ec) {
+                return;
+            }
+            this->reap();
+        }
+
+        const unsigned tail = *sq_tail_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_) {
+            this->submit(ec);
+            if (ec) {
+                return;
+            }
+        }
+
+        const unsigned index = tail & *sq_mask_;
+        ::io_uring_sqe& sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(addr);
+        sqe.len = static_cast<std::uint32_t>(len);
+        sqe.off = static_cast<std::uint64_t>(offset);
+        sqe.user_data = reinterpret_cast<std::uintptr_t>(&op);
+        sq_array_[index] = index;
+
+        op.result = 0;
+        op.complete = false;
+
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        ++to_submit_;
+        ++in_flight_;
+    }
+
+    // Queues a request to cancel `op`. The completion of the cancellation
+    // itself is of no interest, so it is recorded in a member which outlives
+    // it; `op` completes either way.
+    void cancel(operation& op) noexcept
+    {
+        std::error_code ignored;
+        this->queue(IORING_OP_ASYNC_CANCEL, -1, &op, 0, 0, cancel_op_, ignored);
+    }
+
+    unsigned enter(unsigned wait_nr, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        const unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0u;
+        unsigned total_submitted = 0;
+
+        while (true) {
+            errno = 0;
+            int ret = sys_enter(fd_.get(), to_submit_, wait_nr, flags);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    // Retry, including any wait for completions
+                    continue;
+                }
+                ec.assign(errno, std::system_category());
+                break;
+            }
+            to_submit_ -= static_cast<unsigned>(ret);
+            total_submitted += static_cast<unsigned>(ret);
+            if (to_submit_ == 0) {
+                break;
+            }
+        }
+
+        return total_submitted;
+    }
+
+    file_descriptor_handle fd_{};
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    std::size_t sq_ring_size_ = 0;
+    std::size_t cq_ring_size_ = 0;
+    std::size_t sqes_size_ = 0;
+    ::io_uring_sqe* sqes_ = nullptr;
+    ::io_uring_cqe* cqes_ = nullptr;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    unsigned sq_entries_ = 0;
+    unsigned cq_entries_ = 0;
+    unsigned to_submit_ = 0;
+    unsigned in_flight_ = 0;
+    operation cancel_op_{};
+};
+
+/// A single positional transfer for use with `uring_file::read_batch()` and
+/// `uring_file::write_batch()`
+template <typename Buffer>
+struct uring_request {
+    /// Offset from the start of the file at which to perform the transfer
+    ::off_t offset = 0;
+    /// The buffer to transfer into or out of
+    Buffer buffer{};
+    /// On completion, the number of bytes transferred
+    std::size_t bytes_transferred = 0;
+    /// On completion, the error (if any) which occurred
+    std::error_code error{};
+    /// Completion state, for use by the ring
+    uring::operation operation{};
+};
+
+using uring_read_request = uring_request<io::mutable_buffer>;
+using uring_write_request = uring_request<io::const_buffer>;
+
+/// A file whose reads and writes are performed via a (shared) `uring`.
+///
+/// The stream interface (`read_some()`, `write_some()` and `seek()`) behaves
+/// exactly like `posix::file`, using the file descriptor's cursor. In addition,
+/// `read_batch()` and `write_batch()` queue many positional transfers on the
+/// ring and submit them to the kernel together, so that N reads cost a
+/// handful of system calls rather than N.
+///
+/// The ring must outlive any `uring_file` which uses it.
+class uring_file {
+public:
+    using offset_type = ::off_t;
+    using position_type = io::stream_position<offset_type>;
+    using native_handle_type = int;
+
+    uring_file() = default;
+
+    uring_file(uring& ring, posix::file_descriptor_handle fd) noexcept
+            : ring_(std::addressof(ring)),
+              fd_(std::move(fd))
+    {}
+
+    uring_file(uring& ring,
+               const io_std::filesystem::path& path,
+               open_mode mode,
+               io_std::filesystem::perms create_perms = default_creation_perms)
+            : ring_(std::addressof(ring))
+    {
+        this->open(path, mode, create_perms);
+    }
+
+    void open(const io_std::filesystem::path& path,
+              open_mode mode,
+              io_std::filesystem::perms create_perms = default_creation_perms)
+    {
+        std::error_code ec;
+        this->open(path, mode, create_perms, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    void open(const io_std::filesystem::path& path,
+              open_mode mode,
+              io_std::filesystem::perms create_perms,
+              std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+
+        int new_fd = ::open(path.c_str(), detail::open_mode_to_posix_mode(mode),
+                            static_cast<::mode_t>(create_perms));
+
+        if (new_fd < 0) {
+            ec.assign(errno, std::system_category());
+            return;
+        }
+
+        fd_ = posix::file_descriptor_handle{new_fd};
+    }
+
+    void close()
+    {
+        std::error_code ec;
+        this->close(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    void close(std::error_code& ec) noexcept
+    {
+        fd_.close(ec);
+    }
+
+    native_handle_type native_handle() const noexcept { return fd_.get(); }
+
+    /// Returns the ring used by this file
+    uring& ring() const noexcept { return *ring_; }
+
+    // SyncReadStream implementation
+
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb)
+    {
+        std::error_code ec;
+        auto sz = this->read_some(mb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return sz;
+    }
+
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb, std::error_code& ec) noexcept
+    {
+        static_assert(is_mutable_buffer_sequence_v<MutBufSeq>,
+                      "Argument passed to read_some() is not a MutableBufferSequence");
+
+        ec.clear();
+
+        if (buffer_size(mb) == 0) {
+            return 0;
+        }
+
+        auto bytes = detail::transfer_buffer_sequence(mb, true,
+                [&] (const ::iovec* iovs, int count, std::size_t) -> ::ssize_t {
+            uring::operation op;
+            ring_->queue_readv(native_handle(), iovs, count, -1, op, ec);
+            if (ec) {
+                return -1;
+            }
+            // If the ring failed, the operation may still have completed
+            // before it could be cancelled
+            ring_->wait(op, ec);
+            if (op.result < 0) {
+                errno = -op.result;
+                return -1;
+            }
+            ec.clear();
+            return op.result;
+        });
+
+        return this->complete_read(bytes, ec);
+    }
+
+    // SyncWriteStream implementation
+
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb)
+    {
+        std::error_code ec;
+        auto sz = this->write_some(cb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return sz;
+    }
+
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb, std::error_code& ec) noexcept
+    {
+        static_assert(is_const_buffer_sequence_v<ConstBufSeq>,
+                      "Argument passed to write_some() is not a ConstBufferSequence");
+
+        ec.clear();
+
+        if (io::buffer_size(cb) == 0) {
+            return 0;
+        }
+
+        auto bytes = detail::transfer_buffer_sequence(cb, true,
+                [&] (const ::iovec* iovs, int count, std::size_t) -> ::ssize_t {
+            uring::operation op;
+            ring_->queue_writev(native_handle(), iovs, count, -1, op, ec);
+            if (ec) {
+                return -1;
+            }
+            // If the ring failed, the operation may still have completed
+            // before it could be cancelled
+            ring_->wait(op, ec);
+            if (op.result < 0) {
+                errno = -op.result;
+                return -1;
+            }
+            ec.clear();
+            return op.result;
+        });
+
+        return this->complete_write(bytes, ec);
+    }
+
+    position_type seek(offset_type offset, seek_mode from)
+    {
+        std::error_code ec;
+        auto o = this->seek(offset, from, ec);
+        if (ec) {
+            throw std::system_error(ec);
+        }
+        return o;
+    }
+
+    position_type
+    seek(offset_type offset, seek_mode from, std::error_code& ec) noexcept
+    {
+        ec.clear();
+        errno = 0;
+        auto o = ::lseek(native_handle(), offset,
+                         detail::seek_mode_to_whence_arg(from));
+
+        if (o < 0) {
+            ec.assign(errno, std::system_category());
+            return position_type{};
+        }
+
+        return position_type{o};
+    }
+
+    void sync(std::error_code& ec) noexcept
+    {
+        ec.clear();
+        if (::fsync(this->native_handle()) != 0) {
+            ec.assign(errno, std::system_category());
+        }
+    }
+
+    void sync()
+    {
+        std::error_code ec{};
+        this->sync(ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+    }
+
+    // Batched positional I/O
+
+    /// Performs every read in the range `[first, last)` of `uring_read_request`s,
+    /// submitting them to the kernel in batches of up to `ring().entries()`
+    /// and then waiting for all of them to complete. The file cursor is not
+    /// used or modified.
+    ///
+    /// The result of each read is stored in its request; reaching the end of
+    /// the file is reported as `stream_errc::eof`. `ec` is only set if the
+    /// ring itself fails.
+    /// @returns The total number of bytes read
+    template <typename Iterator>
+    std::size_t read_batch(Iterator first, Iterator last, std::error_code& ec) noexcept
+    {
+        ec.clear();
+
+        auto it = first;
+        for (; it != last; ++it) {
+            ring_->queue_read(native_handle(), it->buffer, it->offset,
+                              it->operation, ec);
+            if (ec) {
+                // Requests which were already queued must still be waited
+                // for, as the kernel holds pointers into them
+                std::error_code ignored;
+                this->complete_batch(first, it, true, ignored);
+                return 0;
+            }
+        }
+
+        return this->complete_batch(first, last, true, ec);
+    }
+
+    /// @overload
+    template <typename Iterator>
+    std::size_t read_batch(Iterator first, Iterator last)
+    {
+        std::error_code ec;
+        auto sz = this->read_batch(first, last, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return sz;
+    }
+
+    /// Performs every write in the range `[first, last)` of
+    /// `uring_write_request`s, submitting them to the kernel in batches of up
+    /// to `ring().entries()` and then waiting for all of them to complete. The
+    /// file cursor is not used or modified.
+    ///
+    /// The result of each write is stored in its request. `ec` is only set if
+    /// the ring itself fails.
+    /// @returns The total number of bytes written
+    template <typename Iterator>
+    std::size_t write_batch(Iterator first, Iterator last, std::error_code& ec) noexcept
+    {
+        ec.clear();
+
+        auto it = first;
+        for (; it != last; ++it) {
+            ring_->queue_write(native_handle(), it->buffer, it->offset,
+                               it->operation, ec);
+            if (ec) {
+                // Requests which were already queued must still be waited
+                // for, as the kernel holds pointers into them
+                std::error_code ignored;
+                this->complete_batch(first, it, false, ignored);
+                return 0;
+            }
+        }
+
+        return this->complete_batch(first, last, false, ec);
+    }
+
+    /// @overload
+    template <typename Iterator>
+    std::size_t write_batch(Iterator first, Iterator last)
+    {
+        std::error_code ec;
+        auto sz = this->write_batch(first, last, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return sz;
+    }
+
+private:
+    std::size_t complete_read(::ssize_t bytes, std::error_code& ec) noexcept
+    {
+        if (ec) {
+            // The ring itself failed
+            return bytes > 0 ? static_cast<std::size_t>(bytes) : 0;
+        }
+
+        if (bytes == 0) {
+            ec = stream_errc::eof;
+        } else if (bytes < 0) {
+            ec.assign(errno, std::system_category());
+            return 0;
+        }
+
+        return static_cast<std::size_t>(bytes);
+    }
+
+    std::size_t complete_write(::ssize_t bytes, std::error_code& ec) noexcept
+    {
+        if (ec) {
+            // The ring itself failed
+            return bytes > 0 ? static_cast<std::size_t>(bytes) : 0;
+        }
+
+        if (bytes < 0) {
+            ec.assign(errno, std::system_category());
+            return 0;
+        }
+
+        return static_cast<std::size_t>(bytes);
+    }
+
+    template <typename Iterator>
+    std::size_t complete_batch(Iterator first, Iterator last, bool is_read,
+                               std::error_code& ec) noexcept
+    {
+        std::size_t total_bytes = 0;
+
+        // Every request must be waited for, even after the ring has failed,
+        // as the kernel holds pointers into them
+        for (auto it = first; it != last; ++it) {
+            std::error_code wait_ec;
+            ring_->wait(it->operation, wait_ec);
+            if (wait_ec && !ec) {
+                ec = wait_ec;
+            }
+
+            const int result = it->operation.result;
+            it->error.clear();
+            it->bytes_transferred = 0;
+
+            if (result < 0) {
+                it->error.assign(-result, std::system_category());
+            } else {
+                if (result == 0 && is_read && it->buffer.size() != 0) {
+                    it->error = stream_errc::eof;
+                }
+                it->bytes_transferred = static_cast<std::size_t>(result);
+                total_bytes += it->bytes_transferred;
+            }
+        }
+
+        return total_bytes;
+    }
+
+    uring* ring_ = nullptr;
+    file_descriptor_handle fd_{};
+};
+
+static_assert(is_sync_read_stream_v<uring_file>,
+              "uring_file does not meet the SyncReadStream requirements");
+static_assert(is_sync_write_stream_v<uring_file>,
+              "uring_file does not meet the SyncWriteStream requirements");
+static_assert(is_seekable_stream_v<uring_file>,
+              "uring_file does not meet the SeekableStream requirements");
+
+} // end namespace posix
+} // end namespace io
+
+#endif // IO_POSIX_URING_FILE_HPP
@@ -0,0 +1,337 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_PREFETCHING_READ_STREAM_HPP
+#define IO_PREFETCHING_READ_STREAM_HPP
+
+#include <io/buffer.hpp>
+#include <io/traits.hpp>
+#include <io/io_std/optional.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace io {
+
+/// A read stream which reads ahead from the next layer on a background
+/// thread, so that reading and processing the data overlap.
+///
+/// The I/O thread fills up to `buffer_count()` buffers of `buffer_size()`
+/// bytes each while the consumer works through the one it is reading from.
+/// The stream offers the same reading operations as `buffered_read_stream`.
+///
+/// If the next layer is seekable, so is this stream: a seek waits for any
+/// read in progress, discards the data read ahead and moves the next layer.
+/// An error (including end of file) from the next layer is reported once
+/// the data read before it has been consumed, and stops any further reading
+/// ahead until the next seek.
+///
+/// The stream may only be used from one thread at a time, and the next layer
+/// must not be used directly.
+template <typename Stream, typename Allocator = std::allocator<unsigned char>>
+class prefetching_read_stream {
+public:
+    using next_layer_type = std::remove_reference_t<Stream>;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+
+    static constexpr size_type default_buffer_size = 64 * 1024;
+    static constexpr size_type default_buffer_count = 2;
+
+    explicit prefetching_read_stream(Stream base,
+                                     size_type buffer_size = default_buffer_size,
+                                     size_type buffer_count = default_buffer_count,
+                                     const allocator_type& allocator = allocator_type{})
+        : base_(std::forward<Stream>(base))
+    {
+        buffer_count = std::max<size_type>(buffer_count, 1);
+        buffers_.reserve(buffer_count);
+        for (size_type i = 0; i < buffer_count; i++) {
+            buffers_.push_back(slot{buffer_vector(std::max<size_type>(buffer_size, 1),
+                                                  allocator), 0, 0, {}});
+            free_.push_back(i);
+        }
+        worker_ = std::thread{[this] { this->run(); }};
+    }
+
+    prefetching_read_stream(const prefetching_read_stream&) = delete;
+    prefetching_read_stream& operator=(const prefetching_read_stream&) = delete;
+
+    /// Stops the I/O thread, waiting for any read in progress
+    ~prefetching_read_stream()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        work_cond_.notify_one();
+        worker_.join();
+    }
+
+    next_layer_type& next_layer() { return base_; }
+
+    const next_layer_type& next_layer() const { return base_; }
+
+    size_type buffer_size() const noexcept { return buffers_.front().data.size(); }
+
+    size_type buffer_count() const noexcept { return buffers_.size(); }
+
+    /* SyncReadStream implementation */
+
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb)
+    {
+        std::error_code ec;
+        const auto bytes_read = this->read_some(mb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return bytes_read;
+    }
+
+    template <typename MutBufSeq>
+    std::size_t read_some(const MutBufSeq& mb, std::error_code& ec)
+    {
+        static_assert(is_mutable_buffer_sequence_v<MutBufSeq>,
+                      "Argument passed to read_some() is not a MutableBufferSequence");
+
+        ec.clear();
+        if (io::buffer_size(mb) == 0 || !this->acquire(ec)) {
+            return 0;
+        }
+
+        auto& buf = this->current();
+        const auto bytes_copied = io::buffer_copy(mb, this->unread(buf));
+        buf.pos += bytes_copied;
+        return bytes_copied;
+    }
+
+    template <typename MutBufSeq>
+    std::size_t peek(const MutBufSeq& mb)
+    {
+        std::error_code ec;
+        const auto bytes_read = this->peek(mb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return bytes_read;
+    }
+
+    /// Copies data into `mb` without consuming it. At most the remainder of
+    /// the current buffer is copied.
+    template <typename MutBufSeq>
+    std::size_t peek(const MutBufSeq& mb, std::error_code& ec)
+    {
+        ec.clear();
+        if (!this->acquire(ec)) {
+            return 0;
+        }
+        return io::buffer_copy(mb, this->unread(this->current()));
+    }
+
+    unsigned char read_next()
+    {
+        std::error_code ec;
+        const auto opt = this->read_next(ec);
+        if (!opt) {
+            throw std::system_error{ec};
+        }
+        return *opt;
+    }
+
+    io_std::optional<unsigned char> read_next(std::error_code& ec)
+    {
+        auto opt = this->peek_next(ec);
+        if (opt) {
+            ++this->current().pos;
+        }
+        return opt;
+    }
+
+    unsigned char peek_next()
+    {
+        std::error_code ec;
+        const auto opt = this->peek_next(ec);
+        if (!opt) {
+            throw std::system_error{ec};
+        }
+        return *opt;
+    }
+
+    io_std::optional<unsigned char> peek_next(std::error_code& ec)
+    {
+        ec.clear();
+        if (!this->acquire(ec)) {
+            return io_std::nullopt;
+        }
+        const auto& buf = this->current();
+        return buf.data[buf.pos];
+    }
+
+    /* SeekableStream implementation */
+
+    template <typename S = next_layer_type,
+              typename = std::enable_if_t<is_seekable_stream_v<S>>>
+    io::position_type<S> seek(io::offset_type<S> distance, io::seek_mode from)
+    {
+        std::error_code ec;
+        const auto pos = this->seek(distance, from, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return pos;
+    }
+
+    /// Discards the data read ahead, and moves the next layer. A seek relative
+    /// to the current position is relative to the data consumed so far.
+    template <typename S = next_layer_type,
+              typename = std::enable_if_t<is_seekable_stream_v<S>>>
+    io::position_type<S> seek(io::offset_type<S> distance, io::seek_mode from,
+                              std::error_code& ec)
+    {
+        ec.clear();
+
+        std::unique_lock<std::mutex> lock{mutex_};
+        paused_ = true;
+        done_cond_.wait(lock, [this] { return !busy_; });
+
+        // Everything read ahead but not yet consumed
+        size_type unread = 0;
+        if (current_ != no_buffer) {
+            unread += this->current().size - this->current().pos;
+            free_.push_back(current_);
+            current_ = no_buffer;
+        }
+        for (const auto index : ready_) {
+            unread += buffers_[index].size;
+            free_.push_back(index);
+        }
+        ready_.clear();
+        stopped_ = false;
+
+        if (from == io::seek_mode::current) {
+            distance -= static_cast<io::offset_type<S>>(unread);
+        }
+        const auto pos = base_.seek(distance, from, ec);
+
+        paused_ = false;
+        work_cond_.notify_one();
+        return pos;
+    }
+
+private:
+    using buffer_vector = std::vector<unsigned char, allocator_type>;
+
+    struct slot {
+        buffer_vector data;
+        size_type size;
+        size_type pos;
+        // The error which ended the read that filled this buffer
+        std::error_code ec;
+    };
+
+    static constexpr size_type no_buffer = static_cast<size_type>(-1);
+
+    slot& current() { return buffers_[current_]; }
+
+    static io::const_buffer unread(const slot& buf) noexcept
+    {
+        return io::buffer(buf.data.data() + buf.pos, buf.size - buf.pos);
+    }
+
+    // Makes sure that the current buffer has data to be read, waiting for the
+    // I/O thread if necessary
+    bool acquire(std::error_code& ec)
+    {
+        if (current_ != no_buffer) {
+            const auto& buf = this->current();
+            if (buf.pos < buf.size) {
+                return true;
+            }
+            if (buf.ec) {
+                // Keep the buffer, so that the error is reported again
+                ec = buf.ec;
+                return false;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock{mutex_};
+        if (current_ != no_buffer) {
+            free_.push_back(current_);
+            current_ = no_buffer;
+            work_cond_.notify_one();
+        }
+
+        done_cond_.wait(lock, [this] { return !ready_.empty(); });
+        current_ = ready_.front();
+        ready_.pop_front();
+        lock.unlock();
+
+        const auto& buf = this->current();
+        if (buf.size == 0) {
+            ec = buf.ec;
+            return false;
+        }
+        return true;
+    }
+
+    // The I/O thread
+    void run()
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+
+        while (true) {
+            work_cond_.wait(lock, [this] {
+                return stop_ || (!free_.empty() && !paused_ && !stopped_);
+            });
+            if (stop_) {
+                return;
+            }
+
+            const auto index = free_.back();
+            free_.pop_back();
+            busy_ = true;
+            lock.unlock();
+
+            auto& buf = buffers_[index];
+            buf.pos = 0;
+            buf.ec.clear();
+            buf.size = base_.read_some(io::buffer(buf.data.data(), buf.data.size()),
+                                       buf.ec);
+
+            lock.lock();
+            busy_ = false;
+            if (buf.ec) {
+                stopped_ = true;
+            }
+            ready_.push_back(index);
+            done_cond_.notify_all();
+        }
+    }
+
+    Stream base_;
+    std::vector<slot> buffers_;
+    size_type current_ = no_buffer;
+
+    std::mutex mutex_;
+    std::condition_variable work_cond_;
+    std::condition_variable done_cond_;
+    std::deque<size_type> ready_;
+    std::vector<size_type> free_;
+    bool busy_ = false;
+    bool paused_ = false;
+    bool stopped_ = false; // after an error, until the next seek
+    bool stop_ = false;
+
+    std::thread worker_;
+};
+
+} // end namespace io
+
+#endif // IO_PREFETCHING_READ_STREAM_HPP
@@ -0,0 +1,66 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_READ_AT_HPP
+#define IO_READ_AT_HPP
+
+#include <io/buffer.hpp>
+#include <io/traits.hpp>
+
+namespace io {
+
+/// Reads from `stream` starting at `offset` until every buffer in `mb` has
+/// been filled or an error occurs, without using the stream's cursor.
+/// Reaching the end of the stream before the buffers are full is reported as
+/// `stream_errc::eof`.
+/// @returns The total number of bytes read
+template <typename RandomAccessReadStream, typename MutBufSeq,
+          typename = std::enable_if_t<is_random_access_read_stream_v<RandomAccessReadStream>>>
+std::size_t read_at(RandomAccessReadStream& stream,
+                    offset_type<RandomAccessReadStream> offset,
+                    const MutBufSeq& mb, std::error_code& ec)
+{
+    static_assert(is_mutable_buffer_sequence_v<MutBufSeq>,
+                  "Argument passed to read_at() is not a MutableBufferSequence");
+
+    ec.clear();
+    std::size_t total_bytes_read = 0;
+
+    for (auto it = buffer_sequence_begin(mb);
+         it != buffer_sequence_end(mb); ++it) {
+        mutable_buffer buf = *it;
+        while (buf.size() > 0) {
+            const auto bytes_read = stream.read_some_at(
+                    offset + static_cast<offset_type<RandomAccessReadStream>>(total_bytes_read),
+                    buf, ec);
+            buf += bytes_read;
+            total_bytes_read += bytes_read;
+            if (ec) {
+                return total_bytes_read;
+            }
+        }
+    }
+
+    return total_bytes_read;
+}
+
+/// @overload
+template <typename RandomAccessReadStream, typename MutBufSeq,
+          typename = std::enable_if_t<is_random_access_read_stream_v<RandomAccessReadStream>>>
+std::size_t read_at(RandomAccessReadStream& stream,
+                    offset_type<RandomAccessReadStream> offset,
+                    const MutBufSeq& mb)
+{
+    std::error_code ec;
+    std::size_t bytes_read = io::read_at(stream, offset, mb, ec);
+    if (ec) {
+        throw std::system_error{ec};
+    }
+    return bytes_read;
+}
+
+} // end namespace io
+
+#endif // IO_READ_AT_HPP
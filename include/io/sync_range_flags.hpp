@@ -0,0 +1,52 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_SYNC_RANGE_FLAGS_HPP
+#define IO_SYNC_RANGE_FLAGS_HPP
+
+#include <type_traits>
+
+namespace io {
+
+/// Flags controlling how a byte range of a file is written back to storage
+enum class sync_range_flags {
+    /// Wait for any write-out of the range which is already in progress
+    /// This is equivalent to the Linux flag `SYNC_FILE_RANGE_WAIT_BEFORE`
+    wait_before = 1,
+
+    /// Start write-out of all dirty pages in the range which are not already
+    /// being written
+    /// This is equivalent to the Linux flag `SYNC_FILE_RANGE_WRITE`
+    write = 2,
+
+    /// Wait for write-out of the range to complete
+    /// This is equivalent to the Linux flag `SYNC_FILE_RANGE_WAIT_AFTER`
+    wait_after = 4
+};
+
+/// Bitwise `and` operation for `sync_range_flags`
+constexpr sync_range_flags operator&(sync_range_flags lhs, sync_range_flags rhs)
+{
+    using u = std::underlying_type_t<sync_range_flags>;
+    return static_cast<sync_range_flags>(static_cast<u>(lhs) & static_cast<u>(rhs));
+}
+
+/// Bitwise `or` operation for `sync_range_flags`
+constexpr sync_range_flags operator|(sync_range_flags lhs, sync_range_flags rhs)
+{
+    using u = std::underlying_type_t<sync_range_flags>;
+    return static_cast<sync_range_flags>(static_cast<u>(lhs) | static_cast<u>(rhs));
+}
+
+/// Bitwise `or` assignment operator for `sync_range_flags`
+constexpr sync_range_flags& operator|=(sync_range_flags& lhs, sync_range_flags rhs)
+{
+    lhs = lhs | rhs;
+    return lhs;
+}
+
+} // end namespace io
+
+#endif // IO_SYNC_RANGE_FLAGS_HPP
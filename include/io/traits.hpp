@@ -45,6 +45,34 @@ template <typename T>
 using write_some_ec_t = decltype(std::declval<T>().write_some(std::declval<const io::const_buffer>(),
                                                               std::declval<std::error_code&>()));
 
+template <typename T>
+using read_some_at_t = decltype(std::declval<T>().read_some_at(0, std::declval<io::mutable_buffer>()));
+
+template <typename T>
+using read_some_at_ec_t = decltype(std::declval<T>().read_some_at(0, std::declval<io::mutable_buffer>(),
+                                                                  std::declval<std::error_code&>()));
+
+template <typename T>
+using write_some_at_t = decltype(std::declval<T>().write_some_at(0, std::declval<const io::const_buffer>()));
+
+template <typename T>
+using write_some_at_ec_t = decltype(std::declval<T>().write_some_at(0, std::declval<const io::const_buffer>(),
+                                                                    std::declval<std::error_code&>()));
+
+// A stand-in for a completion handler with signature
+// void(std::error_code, std::size_t), for use in unevaluated contexts
+struct transfer_handler_archetype {
+    void operator()(std::error_code, std::size_t) const;
+};
+
+template <typename T>
+using async_read_some_t = decltype(std::declval<T>().async_read_some(
+        std::declval<io::mutable_buffer>(), std::declval<transfer_handler_archetype>()));
+
+template <typename T>
+using async_write_some_t = decltype(std::declval<T>().async_write_some(
+        std::declval<const io::const_buffer>(), std::declval<transfer_handler_archetype>()));
+
 template <typename T>
 using seek_result_t = decltype(std::declval<T>().seek(0, io::seek_mode::current));
 
@@ -89,6 +117,38 @@ struct is_sync_write_stream_impl<T, void_t<
     std::is_same<std::size_t, write_some_ec_t<T>>
 >> : std::true_type {};
 
+template <typename T, typename = void>
+struct is_random_access_read_stream_impl : std::false_type {};
+
+template <typename T>
+struct is_random_access_read_stream_impl<T, void_t<
+    std::enable_if_t<std::is_same<std::size_t, read_some_at_t<T>>::value>,
+    std::enable_if_t<std::is_same<std::size_t, read_some_at_ec_t<T>>::value>
+>> : std::true_type {};
+
+template <typename T, typename = void>
+struct is_random_access_write_stream_impl : std::false_type {};
+
+template <typename T>
+struct is_random_access_write_stream_impl<T, void_t<
+    std::enable_if_t<std::is_same<std::size_t, write_some_at_t<T>>::value>,
+    std::enable_if_t<std::is_same<std::size_t, write_some_at_ec_t<T>>::value>
+>> : std::true_type {};
+
+template <typename T, typename = void>
+struct is_async_read_stream_impl : std::false_type {};
+
+template <typename T>
+struct is_async_read_stream_impl<T, void_t<async_read_some_t<T>>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct is_async_write_stream_impl : std::false_type {};
+
+template <typename T>
+struct is_async_write_stream_impl<T, void_t<async_write_some_t<T>>>
+    : std::true_type {};
+
 template <typename T, typename = void>
 struct is_seekable_stream_impl : std::false_type {};
 
@@ -99,6 +159,14 @@ struct is_seekable_stream_impl<T, void_t<
     std::enable_if_t<is_stream_position_impl<seek_result_t<T>>::value>
 >> : std::true_type {};
 
+template <typename Stream, typename = void>
+struct has_native_fd : std::false_type {};
+
+template <typename Stream>
+struct has_native_fd<Stream, void_t<
+    std::enable_if_t<std::is_same<int, decltype(std::declval<const Stream&>().native_handle())>::value>
+>> : std::true_type {};
+
 }
 
 template <typename T>
@@ -119,6 +187,39 @@ using is_seekable_stream = detail::is_seekable_stream_impl<T>;
 template <typename T>
 constexpr bool is_seekable_stream_v = is_seekable_stream<T>::value;
 
+template <typename T>
+using is_random_access_read_stream = detail::is_random_access_read_stream_impl<T>;
+
+template <typename T>
+constexpr bool is_random_access_read_stream_v = is_random_access_read_stream<T>::value;
+
+template <typename T>
+using is_random_access_write_stream = detail::is_random_access_write_stream_impl<T>;
+
+template <typename T>
+constexpr bool is_random_access_write_stream_v = is_random_access_write_stream<T>::value;
+
+/// A SyncReadStream which exposes its internal buffer, through `data()`,
+/// `consume()` and `fill()`, so that it can be parsed without copying
+template <typename T>
+using is_buffered_read_stream = detail::conjunction<
+        detail::is_sync_read_stream_impl<T>, net::detail::has_borrowed_read<T>>;
+
+template <typename T>
+constexpr bool is_buffered_read_stream_v = is_buffered_read_stream<T>::value;
+
+template <typename T>
+using is_async_read_stream = detail::is_async_read_stream_impl<T>;
+
+template <typename T>
+constexpr bool is_async_read_stream_v = is_async_read_stream<T>::value;
+
+template <typename T>
+using is_async_write_stream = detail::is_async_write_stream_impl<T>;
+
+template <typename T>
+constexpr bool is_async_write_stream_v = is_async_write_stream<T>::value;
+
 template <typename T>
 using position_type = detail::seek_result_t<T>;
 
@@ -0,0 +1,64 @@
+
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef IO_WRITE_AT_HPP
+#define IO_WRITE_AT_HPP
+
+#include <io/buffer.hpp>
+#include <io/traits.hpp>
+
+namespace io {
+
+/// Writes to `stream` starting at `offset` until every buffer in `cb` has
+/// been written or an error occurs, without using the stream's cursor.
+/// @returns The total number of bytes written
+template <typename RandomAccessWriteStream, typename ConstBufSeq,
+          typename = std::enable_if_t<is_random_access_write_stream_v<RandomAccessWriteStream>>>
+std::size_t write_at(RandomAccessWriteStream& stream,
+                     offset_type<RandomAccessWriteStream> offset,
+                     const ConstBufSeq& cb, std::error_code& ec)
+{
+    static_assert(is_const_buffer_sequence_v<ConstBufSeq>,
+                  "Argument passed to write_at() is not a ConstBufferSequence");
+
+    ec.clear();
+    std::size_t total_bytes_written = 0;
+
+    for (auto it = buffer_sequence_begin(cb);
+         it != buffer_sequence_end(cb); ++it) {
+        const_buffer buf = *it;
+        while (buf.size() > 0) {
+            const auto bytes_written = stream.write_some_at(
+                    offset + static_cast<offset_type<RandomAccessWriteStream>>(total_bytes_written),
+                    buf, ec);
+            buf += bytes_written;
+            total_bytes_written += bytes_written;
+            if (ec) {
+                return total_bytes_written;
+            }
+        }
+    }
+
+    return total_bytes_written;
+}
+
+/// @overload
+template <typename RandomAccessWriteStream, typename ConstBufSeq,
+          typename = std::enable_if_t<is_random_access_write_stream_v<RandomAccessWriteStream>>>
+std::size_t write_at(RandomAccessWriteStream& stream,
+                     offset_type<RandomAccessWriteStream> offset,
+                     const ConstBufSeq& cb)
+{
+    std::error_code ec;
+    std::size_t bytes_written = io::write_at(stream, offset, cb, ec);
+    if (ec) {
+        throw std::system_error{ec};
+    }
+    return bytes_written;
+}
+
+} // end namespace io
+
+#endif // IO_WRITE_AT_HPP
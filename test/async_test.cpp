@@ -0,0 +1,205 @@
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifdef __linux__
+
+#include "catch.hpp"
+
+#include <io/async.hpp>
+#include <io/posix/async_descriptor_stream.hpp>
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+struct async_pipe {
+    async_pipe(io::posix::epoll_reactor& reactor)
+        : async_pipe(reactor, make_pipe())
+    {}
+
+    io::posix::async_descriptor_stream read_end;
+    io::posix::async_descriptor_stream write_end;
+
+private:
+    struct fds { int read; int write; };
+
+    static fds make_pipe()
+    {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        return {fds[0], fds[1]};
+    }
+
+    async_pipe(io::posix::epoll_reactor& reactor, fds p)
+        : read_end(reactor, io::posix::file_descriptor_handle{p.read}),
+          write_end(reactor, io::posix::file_descriptor_handle{p.write})
+    {}
+};
+
+}
+
+TEST_CASE("async_read_until reads lines from many pipes on one thread", "[async]")
+{
+    io::posix::epoll_reactor reactor;
+
+    constexpr int num_pipes = 100;
+    std::vector<std::unique_ptr<async_pipe>> pipes;
+    std::vector<std::string> buffers(num_pipes);
+    std::vector<std::string> lines(num_pipes);
+    int completed = 0;
+
+    for (int i = 0; i < num_pipes; i++) {
+        pipes.push_back(std::make_unique<async_pipe>(reactor));
+
+        io::async_read_until(pipes[i]->read_end, io::dynamic_buffer(buffers[i]), '\n',
+                [&, i] (std::error_code ec, std::size_t n) {
+            REQUIRE_FALSE(ec);
+            lines[i] = buffers[i].substr(0, n);
+            ++completed;
+        });
+    }
+
+    // Nothing has been written yet, so nothing can have completed
+    REQUIRE(completed == 0);
+
+    // Write each line in two pieces, so that every read has to wait twice
+    for (int i = 0; i < num_pipes; i++) {
+        reactor.post([&, i] {
+            static const std::string first = "Hello ";
+            io::async_write(pipes[i]->write_end, io::buffer(first),
+                    [&, i] (std::error_code ec, std::size_t) {
+                REQUIRE_FALSE(ec);
+                static const std::string second = "world\nextra";
+                io::async_write(pipes[i]->write_end, io::buffer(second),
+                                [] (std::error_code ec, std::size_t n) {
+                    REQUIRE_FALSE(ec);
+                    REQUIRE(n == 11);
+                });
+            });
+        });
+    }
+
+    reactor.run();
+
+    REQUIRE(completed == num_pipes);
+    for (int i = 0; i < num_pipes; i++) {
+        REQUIRE(lines[i] == "Hello world\n");
+    }
+    REQUIRE(reactor.pending() == 0);
+}
+
+TEST_CASE("async_write waits for a full pipe to drain", "[async]")
+{
+    io::posix::epoll_reactor reactor;
+    async_pipe pipe{reactor};
+
+    // Much larger than the capacity of a pipe
+    const std::string contents(1024 * 1024, 'x');
+    std::string received(contents.size(), '\0');
+    std::size_t bytes_written = 0;
+    std::size_t bytes_read = 0;
+
+    io::async_write(pipe.write_end, io::buffer(contents),
+                    [&] (std::error_code ec, std::size_t n) {
+        REQUIRE_FALSE(ec);
+        bytes_written = n;
+    });
+
+    io::async_read(pipe.read_end, io::buffer(received),
+                   [&] (std::error_code ec, std::size_t n) {
+        REQUIRE_FALSE(ec);
+        bytes_read = n;
+    });
+
+    reactor.run();
+
+    REQUIRE(bytes_written == contents.size());
+    REQUIRE(bytes_read == contents.size());
+    REQUIRE(received == contents);
+}
+
+TEST_CASE("epoll_reactor keeps descriptors registered between waits", "[async]")
+{
+    io::posix::epoll_reactor reactor;
+    async_pipe pipe{reactor};
+    const int fd = pipe.read_end.native_handle();
+    int completed = 0;
+
+    const auto is_registered = [&] {
+        ::epoll_event event{};
+        if (::epoll_ctl(reactor.native_handle(), EPOLL_CTL_ADD, fd, &event) == 0) {
+            ::epoll_ctl(reactor.native_handle(), EPOLL_CTL_DEL, fd, nullptr);
+            return false;
+        }
+        return errno == EEXIST;
+    };
+
+    for (int i = 0; i < 2; i++) {
+        reactor.async_wait(fd, io::posix::epoll_reactor::wait_type::read,
+                           [&] (std::error_code ec) {
+            REQUIRE_FALSE(ec);
+            ++completed;
+        });
+        REQUIRE(::write(pipe.write_end.native_handle(), "x", 1) == 1);
+        reactor.run();
+        REQUIRE(completed == i + 1);
+        REQUIRE(is_registered());
+    }
+
+    pipe.read_end.cancel();
+    REQUIRE_FALSE(is_registered());
+}
+
+TEST_CASE("Asynchronous reads report end of file and cancellation", "[async]")
+{
+    io::posix::epoll_reactor reactor;
+    std::error_code result;
+
+    SECTION("end of file") {
+        async_pipe pipe{reactor};
+        std::string buf;
+        io::async_read_until(pipe.read_end, io::dynamic_buffer(buf), "\r\n",
+                             [&] (std::error_code ec, std::size_t) {
+            result = ec;
+        });
+        reactor.post([&] {
+            io::posix::async_descriptor_stream closing = std::move(pipe.write_end);
+        });
+        reactor.run();
+        REQUIRE(result == io::stream_errc::not_found);
+    }
+
+    SECTION("cancellation") {
+        async_pipe pipe{reactor};
+        char buf[16];
+        io::async_read(pipe.read_end, io::buffer(buf),
+                       [&] (std::error_code ec, std::size_t) {
+            result = ec;
+        });
+        reactor.post([&] { pipe.read_end.cancel(); });
+        reactor.run();
+        REQUIRE(result == std::errc::operation_canceled);
+    }
+
+    SECTION("move assignment") {
+        async_pipe pipe{reactor};
+        async_pipe other{reactor};
+        char buf[16];
+        io::async_read(pipe.read_end, io::buffer(buf),
+                       [&] (std::error_code ec, std::size_t) {
+            result = ec;
+        });
+        REQUIRE(reactor.pending() == 1);
+
+        // Replacing the descriptor cancels the wait on the old one
+        pipe.read_end = std::move(other.read_end);
+        reactor.run();
+        REQUIRE(result == std::errc::operation_canceled);
+    }
+}
+
+#endif // __linux__
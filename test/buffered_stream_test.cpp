@@ -1,9 +1,21 @@
 
 #include "catch.hpp"
 
+#include <io/aligned_allocator.hpp>
+#include <io/async_write_behind_stream.hpp>
 #include <io/buffered_stream.hpp>
+#include <io/prefetching_read_stream.hpp>
 #include <io/string_stream.hpp>
 
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <io/posix/ring_buffer_storage.hpp>
+#endif
+
 const std::string test_string = "The quick brown fox jumped over the lazy dog";
 
 TEST_CASE("Basic buffered_read_stream test")
@@ -29,6 +41,117 @@ TEST_CASE("Basic buffered_read_stream test")
     REQUIRE(buf == test_string.substr(20, 10));
 }
 
+TEST_CASE("buffered_read_stream with aligned storage")
+{
+    using allocator_type = io::aligned_allocator<unsigned char, 16>;
+    io::buffered_read_stream<io::string_stream, allocator_type> stream{
+            io::string_stream{test_string}, 20, allocator_type{}};
+
+    std::string buf(test_string.size(), '\0');
+    std::size_t bytes_read = 0;
+
+    REQUIRE_NOTHROW(bytes_read = io::read(stream, io::buffer(buf)));
+    REQUIRE(bytes_read == test_string.size());
+    REQUIRE(buf == test_string);
+}
+
+TEST_CASE("buffered_read_stream can be read without copying")
+{
+    using stream_type = io::buffered_read_stream<io::string_stream>;
+    static_assert(io::is_buffered_read_stream_v<stream_type>, "");
+    static_assert(io::is_buffered_read_stream_v<io::buffered_stream<io::string_stream>>, "");
+    static_assert(!io::is_buffered_read_stream_v<io::string_stream>, "");
+
+    stream_type stream{io::string_stream{test_string}, 8};
+
+    REQUIRE(stream.data().size() == 0);
+    REQUIRE(stream.fill() == 8);
+    REQUIRE(std::string(static_cast<const char*>(stream.data().data()),
+                        stream.data().size()) == "The quic");
+
+    stream.consume(4);
+    REQUIRE(std::string(static_cast<const char*>(stream.data().data()),
+                        stream.data().size()) == "quic");
+
+    // Filling appends to the data which is still buffered
+    REQUIRE(stream.fill() == 4);
+    REQUIRE(std::string(static_cast<const char*>(stream.data().data()),
+                        stream.data().size()) == "quick br");
+
+    // ...until the buffer is full
+    REQUIRE(stream.fill() == 0);
+
+    stream.consume(100);
+    REQUIRE(stream.data().size() == 0);
+}
+
+TEST_CASE("read_until scans the buffer of a buffered stream")
+{
+    const std::string lines = "first line\r\nsecond line\r\nno delimiter";
+
+    io::buffered_read_stream<io::string_stream> stream{io::string_stream{lines}, 8};
+    std::string str;
+    std::error_code ec;
+
+    REQUIRE(io::read_until(stream, io::dynamic_buffer(str), "\r\n", ec) == 12);
+    REQUIRE_FALSE(ec);
+    REQUIRE(str == "first line\r\n");
+
+    // Data after the delimiter stays in the stream
+    str.clear();
+    REQUIRE(io::read_until(stream, io::dynamic_buffer(str), '\n', ec) == 13);
+    REQUIRE_FALSE(ec);
+    REQUIRE(str == "second line\r\n");
+
+    str.clear();
+    REQUIRE(io::read_until(stream, io::dynamic_buffer(str), "\r\n", ec) == 12);
+    REQUIRE(ec == io::stream_errc::not_found);
+    REQUIRE(str == "no delimiter");
+
+    SECTION("Limited dynamic buffers") {
+        io::buffered_read_stream<io::string_stream> s2{io::string_stream{lines}, 8};
+        str.clear();
+        REQUIRE(io::read_until(s2, io::dynamic_buffer(str, 5), "\r\n", ec) == 5);
+        REQUIRE(ec == io::stream_errc::not_found);
+        REQUIRE(str == "first");
+    }
+}
+
+TEST_CASE("buffered_read_stream with adaptive buffer sizing")
+{
+    const std::string long_string(64 * 1024, 'x');
+
+    io::buffered_read_stream<io::string_stream> stream{io::string_stream{long_string}, 16};
+    stream.set_adaptive(4096);
+    REQUIRE(stream.adaptive());
+    REQUIRE(stream.buffer_capacity() == 16);
+
+    SECTION("Hot streams grow up to the limit") {
+        std::string str;
+        std::error_code ec;
+        while (stream.read_next(ec)) {
+            str += 'x';
+        }
+        REQUIRE(str == long_string);
+        REQUIRE(stream.buffer_capacity() == 4096);
+    }
+
+    SECTION("Occasional reads keep a small buffer") {
+        std::string buf(4, '\0');
+        io::read(stream, io::buffer(buf));
+        REQUIRE(stream.buffer_capacity() == 16);
+    }
+
+    SECTION("Adaptive sizing can be disabled") {
+        stream.set_adaptive(0);
+        std::string buf(1000, '\0');
+        for (int i = 0; i < 10; i++) {
+            io::read(stream, io::buffer(buf.data(), 10));
+        }
+        REQUIRE(stream.buffer_capacity() == 16);
+    }
+}
+
 TEST_CASE("Basic buffered_write_stream test")
 {
     io::buffered_write_stream<io::string_stream> stream{io::string_stream{test_string}, 20};
@@ -36,6 +159,90 @@ TEST_CASE("Basic buffered_write_stream test")
     static_assert(io::is_sync_write_stream_v<decltype(stream)>, "");
 }
 
+namespace {
+
+// A string_stream which counts the calls made to write_some(), and writes
+// at most max_write bytes in each
+struct counting_stream : io::string_stream {
+    using io::string_stream::string_stream;
+
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb, std::error_code& ec)
+    {
+        ++write_calls;
+        std::string data(std::min(io::buffer_size(cb), max_write), '\0');
+        io::buffer_copy(io::buffer(data), cb);
+        return io::string_stream::write_some(io::buffer(data), ec);
+    }
+
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb)
+    {
+        std::error_code ec;
+        const auto bytes_written = this->write_some(cb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return bytes_written;
+    }
+
+    int write_calls = 0;
+    std::size_t max_write = static_cast<std::size_t>(-1);
+};
+
+}
+
+TEST_CASE("buffered_write_stream writes overflowing data in one call")
+{
+    io::buffered_write_stream<counting_stream> stream{counting_stream{}, 16};
+    const auto& base = stream.next_layer();
+
+    const std::string header = "header:";
+    const std::string body(100, 'b');
+
+    io::write(stream, io::buffer(header));
+    REQUIRE(base.write_calls == 0);
+
+    SECTION("Buffered data and a large write are gathered together") {
+        REQUIRE(io::write(stream, io::buffer(body)) == body.size());
+        REQUIRE(base.write_calls == 1);
+        REQUIRE(base.str() == header + body);
+    }
+
+    SECTION("Buffer sequences are gathered too") {
+        const std::array<io::const_buffer, 2> bufs{{
+            io::buffer(body.data(), 50), io::buffer(body.data() + 50, 50)
+        }};
+        REQUIRE(io::write(stream, bufs) == body.size());
+        REQUIRE(base.write_calls == 1);
+        REQUIRE(base.str() == header + body);
+    }
+
+    SECTION("Large writes bypass an empty buffer") {
+        stream.flush();
+        REQUIRE(base.write_calls == 1);
+        REQUIRE(io::write(stream, io::buffer(body)) == body.size());
+        REQUIRE(base.write_calls == 2);
+        REQUIRE(base.str() == header + body);
+    }
+
+    SECTION("Short gathered writes still make progress") {
+        // The next layer only takes some of the buffered data
+        stream.next_layer().max_write = 4;
+        std::error_code ec;
+        const auto bytes_written = stream.write_some(io::buffer(body), ec);
+        REQUIRE_FALSE(ec);
+        REQUIRE(base.str() == header.substr(0, 4));
+
+        // What is left of the header fills the buffer along with the body
+        REQUIRE(bytes_written == 16 - (header.size() - 4));
+
+        stream.next_layer().max_write = static_cast<std::size_t>(-1);
+        stream.flush();
+        REQUIRE(base.str() == header + body.substr(0, bytes_written));
+    }
+}
+
 TEST_CASE("Basic buffered_stream test")
 {
     io::buffered_stream<io::string_stream> stream{io::string_stream{test_string}, 20, 20};
@@ -57,4 +264,368 @@ TEST_CASE("Basic buffered_stream test")
     REQUIRE_NOTHROW(bytes_read = io::read(stream, io::buffer(buf), ec));
     REQUIRE(bytes_read == 10);
     REQUIRE(buf == test_string.substr(20, 10));
-}
\ No newline at end of file
+}
+namespace {
+
+// A string_stream which is slow to write to, and can be made to fail
+struct slow_stream : io::string_stream {
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb, std::error_code& ec)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        if (fail) {
+            ec = std::make_error_code(std::errc::io_error);
+            return 0;
+        }
+        return io::string_stream::write_some(cb, ec);
+    }
+
+    template <typename ConstBufSeq>
+    std::size_t write_some(const ConstBufSeq& cb)
+    {
+        std::error_code ec;
+        auto bytes_written = this->write_some(cb, ec);
+        if (ec) {
+            throw std::system_error{ec};
+        }
+        return bytes_written;
+    }
+
+    void sync(std::error_code& ec) { ec.clear(); ++syncs; }
+
+    bool fail = false;
+    int syncs = 0;
+};
+
+}
+
+TEST_CASE("async_write_behind_stream writes on a background thread")
+{
+    io::async_write_behind_stream<slow_stream> stream{slow_stream{}, 16, 3};
+    static_assert(io::is_sync_write_stream_v<decltype(stream)>, "");
+    REQUIRE(stream.buffer_size() == 16);
+    REQUIRE(stream.buffer_count() == 3);
+
+    std::string expected;
+    for (int i = 0; i < 100; i++) {
+        const auto line = std::to_string(i) + "\n";
+        io::write(stream, io::buffer(line));
+        expected += line;
+    }
+
+    SECTION("flush() waits for outstanding writes") {
+        stream.flush();
+        REQUIRE(stream.next_layer().str() == expected);
+    }
+
+    SECTION("sync() flushes the next layer too") {
+        stream.sync();
+        REQUIRE(stream.next_layer().str() == expected);
+        REQUIRE(stream.next_layer().syncs == 1);
+    }
+
+    SECTION("Errors are reported to the producer") {
+        stream.flush();
+        stream.next_layer().fail = true;
+        std::error_code ec;
+        for (int i = 0; i < 100 && !ec; i++) {
+            io::write(stream, io::buffer(expected), ec);
+        }
+        REQUIRE(ec == std::errc::io_error);
+        stream.flush(ec);
+        REQUIRE(ec == std::errc::io_error);
+
+        // Even a write which would fit in the current buffer is refused
+        REQUIRE(stream.write_some(io::buffer("x", 1), ec) == 0);
+        REQUIRE(ec == std::errc::io_error);
+        stream.next_layer().fail = false;
+    }
+}
+
+TEST_CASE("prefetching_read_stream reads ahead on a background thread")
+{
+    std::string long_string;
+    for (int i = 0; i < 100; i++) {
+        long_string += std::to_string(i) + ",";
+    }
+
+    io::prefetching_read_stream<io::string_stream> stream{
+            io::string_stream{long_string}, 16, 3};
+    static_assert(io::is_sync_read_stream_v<decltype(stream)>, "");
+    static_assert(io::is_seekable_stream_v<decltype(stream)>, "");
+
+    SECTION("Reading everything") {
+        std::string str;
+        REQUIRE(io::read_all(stream, io::dynamic_buffer(str)) == long_string.size());
+        REQUIRE(str == long_string);
+
+        std::error_code ec;
+        REQUIRE_FALSE(stream.read_next(ec));
+        REQUIRE(ec == io::stream_errc::eof);
+    }
+
+    SECTION("Single bytes and peeking") {
+        REQUIRE(stream.peek_next() == '0');
+        REQUIRE(stream.read_next() == '0');
+        REQUIRE(stream.read_next() == ',');
+
+        std::string buf(4, '\0');
+        REQUIRE(stream.peek(io::buffer(buf)) == 4);
+        REQUIRE(buf == "1,2,");
+        REQUIRE(io::read(stream, io::buffer(buf)) == 4);
+        REQUIRE(buf == "1,2,");
+    }
+
+    SECTION("Seeking discards the data read ahead") {
+        std::string buf(5, '\0');
+        io::read(stream, io::buffer(buf));
+
+        stream.seek(10, io::seek_mode::start);
+        io::read(stream, io::buffer(buf));
+        REQUIRE(buf == long_string.substr(10, 5));
+
+        stream.seek(-5, io::seek_mode::current);
+        io::read(stream, io::buffer(buf));
+        REQUIRE(buf == long_string.substr(10, 5));
+
+        stream.seek(-5, io::seek_mode::end);
+        io::read(stream, io::buffer(buf));
+        REQUIRE(buf == long_string.substr(long_string.size() - 5));
+
+        // Reading can start again after the end has been reached
+        std::error_code ec;
+        REQUIRE_FALSE(stream.read_next(ec));
+        stream.seek(0, io::seek_mode::start);
+        REQUIRE(stream.read_next() == '0');
+    }
+}
+
+#ifdef __linux__
+
+TEST_CASE("ring_buffer_storage keeps wrapped data contiguous")
+{
+    io::posix::ring_buffer_storage storage{1000};
+    const auto capacity = storage.capacity();
+    REQUIRE(capacity >= 1000);
+
+    // Fill most of the ring, then consume most of that
+    auto buf = storage.prepare();
+    REQUIRE(buf.size() == capacity);
+    std::memset(buf.data(), 'a', capacity - 10);
+    storage.commit(capacity - 10);
+    storage.consume(capacity - 30);
+
+    // The free space runs contiguously past the end of the ring
+    buf = storage.prepare();
+    REQUIRE(buf.size() == capacity - 20);
+    std::memset(buf.data(), 'b', 100);
+    storage.commit(100);
+
+    const std::string expected = std::string(20, 'a') + std::string(100, 'b');
+    REQUIRE(std::string(static_cast<const char*>(storage.data().data()),
+                        storage.size()) == expected);
+
+    // Consuming past the end wraps around to the start
+    storage.consume(30);
+    REQUIRE(storage.front() == 'b');
+    REQUIRE(storage.size() == 90);
+
+    storage.grow(2 * capacity);
+    REQUIRE(storage.capacity() >= 2 * capacity);
+    REQUIRE(std::string(static_cast<const char*>(storage.data().data()),
+                        storage.size()) == std::string(90, 'b'));
+}
+
+TEST_CASE("Buffered streams with ring buffer storage")
+{
+    std::string lines;
+    for (int i = 0; i < 2000; i++) {
+        lines += "line " + std::to_string(i) + "\n";
+    }
+
+    SECTION("Reading") {
+        io::buffered_read_stream<io::string_stream, std::allocator<unsigned char>,
+                                 io::posix::ring_buffer_storage>
+                stream{io::string_stream{lines}, 4096};
+
+        // Each line is read separately, so that the ring wraps many times
+        std::string str;
+        std::error_code ec;
+        std::size_t line_count = 0;
+        while (io::read_until(stream, io::dynamic_buffer(str), '\n', ec) > 0) {
+            ++line_count;
+        }
+        REQUIRE(ec == io::stream_errc::not_found);
+        REQUIRE(line_count == 2000);
+        REQUIRE(str == lines);
+    }
+
+    SECTION("Writing") {
+        io::buffered_write_stream<io::string_stream, std::allocator<unsigned char>,
+                                  io::posix::ring_buffer_storage>
+                stream{io::string_stream{}, 4096};
+
+        for (int i = 0; i < 2000; i++) {
+            io::write(stream, io::buffer("line " + std::to_string(i) + "\n"));
+        }
+        stream.flush();
+        REQUIRE(stream.next_layer().str() == lines);
+    }
+}
+
+#endif // __linux__
+
+namespace {
+
+// A string_stream which counts the calls made to seek()
+struct seek_counting_stream : io::string_stream {
+    using io::string_stream::string_stream;
+
+    position_type seek(offset_type distance, io::seek_mode from,
+                       std::error_code& ec)
+    {
+        ++seek_calls;
+        return io::string_stream::seek(distance, from, ec);
+    }
+
+    position_type seek(offset_type distance, io::seek_mode from)
+    {
+        ++seek_calls;
+        return io::string_stream::seek(distance, from);
+    }
+
+    int seek_calls = 0;
+};
+
+}
+
+TEST_CASE("buffered_read_stream seeks within its buffer")
+{
+    io::buffered_read_stream<seek_counting_stream> stream{
+            seek_counting_stream{test_string}, 16};
+    const auto& base = stream.next_layer();
+
+    std::string buf(4, '\0');
+    io::read(stream, io::buffer(buf));
+    REQUIRE(buf == "The ");
+
+    // The first position query asks the next layer
+    REQUIRE(stream.get_position().offset_from_start() == 4);
+    REQUIRE(base.seek_calls == 1);
+
+    SECTION("Forward skips") {
+        REQUIRE(stream.seek(6, io::seek_mode::current).offset_from_start() == 10);
+        io::read(stream, io::buffer(buf));
+        REQUIRE(buf == "brow");
+        REQUIRE(base.seek_calls == 1);
+    }
+
+    SECTION("Backtracking") {
+        io::read(stream, io::buffer(buf));
+        REQUIRE(stream.seek(1, io::seek_mode::start).offset_from_start() == 1);
+        io::read(stream, io::buffer(buf));
+        REQUIRE(buf == "he q");
+        REQUIRE(base.seek_calls == 1);
+    }
+
+    SECTION("Seeking to the end of the buffered data") {
+        stream.seek(16, io::seek_mode::start);
+        REQUIRE(stream.read_next() == test_string[16]);
+        REQUIRE(stream.get_position().offset_from_start() == 17);
+        REQUIRE(base.seek_calls == 1);
+    }
+
+    SECTION("Seeks outside the buffer go to the next layer") {
+        stream.seek(30, io::seek_mode::start);
+        io::read(stream, io::buffer(buf));
+        REQUIRE(buf == test_string.substr(30, 4));
+        REQUIRE(base.seek_calls == 2);
+
+        // Relative seeks account for the buffered data
+        stream.seek(-20, io::seek_mode::current);
+        REQUIRE(stream.get_position().offset_from_start() == 14);
+        io::read(stream, io::buffer(buf));
+        REQUIRE(buf == test_string.substr(14, 4));
+        REQUIRE(base.seek_calls == 3);
+    }
+}
+
+namespace {
+
+// An allocator which counts the allocations made through it
+template <typename T>
+struct counting_allocator : std::allocator<T> {
+    template <typename U>
+    struct rebind { using other = counting_allocator<U>; };
+
+    counting_allocator() = default;
+
+    template <typename U>
+    counting_allocator(const counting_allocator<U>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        ++allocation_count;
+        return std::allocator<T>::allocate(n);
+    }
+
+    static int allocation_count;
+};
+
+template <typename T>
+int counting_allocator<T>::allocation_count = 0;
+
+}
+
+TEST_CASE("Buffered streams with inline storage")
+{
+    using allocator_type = counting_allocator<unsigned char>;
+    using storage_type = io::detail::buffered_stream_storage<allocator_type, 64>;
+    allocator_type::allocation_count = 0;
+
+    SECTION("Small buffers are not allocated") {
+        io::buffered_read_stream<io::string_stream, allocator_type, storage_type>
+                stream{io::string_stream{test_string}, 64};
+        REQUIRE(stream.buffer_capacity() == 64);
+
+        std::string str;
+        io::read_all(stream, io::dynamic_buffer(str));
+        REQUIRE(str == test_string);
+        REQUIRE(allocator_type::allocation_count == 0);
+    }
+
+    SECTION("Larger buffers are allocated") {
+        io::buffered_write_stream<io::string_stream, allocator_type, storage_type>
+                stream{io::string_stream{}, 128};
+        io::write(stream, io::buffer(test_string));
+        stream.flush();
+        REQUIRE(stream.next_layer().str() == test_string);
+        REQUIRE(allocator_type::allocation_count == 1);
+    }
+
+    SECTION("Growing keeps the stored data") {
+        storage_type storage{16};
+        REQUIRE(storage.capacity() == 16);
+        REQUIRE_FALSE(storage.on_heap());
+
+        REQUIRE(io::buffer_copy(storage.prepare(), io::buffer(test_string)) == 16);
+        storage.commit(16);
+        storage.consume(10);
+
+        storage.grow(40);
+        REQUIRE_FALSE(storage.on_heap());
+        REQUIRE(storage.capacity() == 40);
+        io::buffer_copy(storage.prepare(), io::buffer(test_string) + 16);
+        storage.commit(24);
+        REQUIRE(storage.size() == 30);
+
+        storage.grow(100);
+        REQUIRE(storage.on_heap());
+        REQUIRE(storage.capacity() == 100);
+        REQUIRE(storage.size() == 30);
+        REQUIRE(storage.rewindable() == 10);
+        const auto data = storage.data();
+        REQUIRE(std::string(static_cast<const char*>(data.data()), 30) ==
+                test_string.substr(10, 30));
+    }
+}
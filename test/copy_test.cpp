@@ -2,8 +2,11 @@
 #include "catch.hpp"
 
 #include <io/copy.hpp>
+#include <io/file.hpp>
 #include <io/string_stream.hpp>
 
+#include <cstdio>
+
 TEST_CASE("io::copy works as expected", "[copy]")
 {
     io::string_stream i{"Hello world"};
@@ -27,3 +30,74 @@ TEST_CASE("io::copy works as expected (throwing)", "[copy]")
     REQUIRE(bytes == i.str().size());
     REQUIRE(i.str() == o.str());
 }
+
+#ifdef __linux__
+
+#include <io/posix/descriptor_stream.hpp>
+
+TEST_CASE("io::copy copies between files", "[copy]")
+{
+    constexpr char src_name[] = "io_copy_test_src.txt";
+    constexpr char dest_name[] = "io_copy_test_dest.txt";
+
+    std::string contents;
+    for (int i = 0; i < 1000; i++) {
+        contents += "Hello world ";
+    }
+
+    {
+        auto src = io::open_file(src_name, io::open_mode::write_only |
+                                           io::open_mode::create |
+                                           io::open_mode::truncate);
+        io::write(src, io::buffer(contents));
+    }
+
+    auto src = io::open_file(src_name, io::open_mode::read_only);
+    auto dest = io::open_file(dest_name, io::open_mode::read_write |
+                                         io::open_mode::create |
+                                         io::open_mode::truncate);
+    std::error_code ec;
+    std::size_t bytes = 0;
+
+    REQUIRE_NOTHROW(bytes = io::copy(src, dest, ec));
+    REQUIRE_FALSE(ec);
+    REQUIRE(bytes == contents.size());
+
+    std::string copied;
+    dest.seek(0, io::seek_mode::start);
+    io::read_all(dest, io::dynamic_buffer(copied));
+    REQUIRE(copied == contents);
+
+    std::remove(src_name);
+    std::remove(dest_name);
+}
+
+TEST_CASE("io::copy copies from a pipe", "[copy]")
+{
+    constexpr char dest_name[] = "io_copy_test_dest.txt";
+    const std::string contents = "Hello world";
+
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+    io::posix::descriptor_stream read_end{io::posix::file_descriptor_handle{fds[0]}};
+    {
+        io::posix::descriptor_stream write_end{io::posix::file_descriptor_handle{fds[1]}};
+        io::write(write_end, io::buffer(contents));
+    }
+
+    auto dest = io::open_file(dest_name, io::open_mode::read_write |
+                                         io::open_mode::create |
+                                         io::open_mode::truncate);
+    std::size_t bytes = 0;
+    REQUIRE_NOTHROW(bytes = io::copy(read_end, dest));
+    REQUIRE(bytes == contents.size());
+
+    std::string copied;
+    dest.seek(0, io::seek_mode::start);
+    io::read_all(dest, io::dynamic_buffer(copied));
+    REQUIRE(copied == contents);
+
+    std::remove(dest_name);
+}
+
+#endif // __linux__
@@ -0,0 +1,98 @@
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifdef __linux__
+
+#include "catch.hpp"
+
+#include <io/posix/descriptor_stream.hpp>
+#include <io/read.hpp>
+
+#include <unistd.h>
+
+#include <array>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct pipe_pair {
+    pipe_pair()
+    {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        read_end = io::posix::descriptor_stream{io::posix::file_descriptor_handle{fds[0]}};
+        write_end = io::posix::descriptor_stream{io::posix::file_descriptor_handle{fds[1]}};
+    }
+
+    io::posix::descriptor_stream read_end;
+    io::posix::descriptor_stream write_end;
+};
+
+}
+
+TEST_CASE("Non-blocking descriptor streams report would_block", "[descriptor_stream]")
+{
+    pipe_pair p;
+    REQUIRE_FALSE(p.read_end.non_blocking());
+    REQUIRE_NOTHROW(p.read_end.set_non_blocking(true));
+    REQUIRE(p.read_end.non_blocking());
+
+    char buf[16];
+    std::error_code ec;
+    REQUIRE(p.read_end.read_some(io::buffer(buf), ec) == 0);
+    REQUIRE(ec == io::stream_errc::would_block);
+
+    REQUIRE_FALSE(p.read_end.wait_readable(std::chrono::milliseconds{10}));
+
+    io::write(p.write_end, io::buffer("x", 1));
+    REQUIRE(p.read_end.wait_readable(std::chrono::milliseconds{0}));
+    REQUIRE(p.read_end.read_some(io::buffer(buf), ec) == 1);
+    REQUIRE_FALSE(ec);
+
+    // A huge timeout must not overflow into an immediate one
+    std::thread writer{[&p] {
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        io::write(p.write_end, io::buffer("x", 1));
+    }};
+    const bool readable = p.read_end.wait_readable(std::chrono::milliseconds::max());
+    writer.join();
+    REQUIRE(readable);
+    REQUIRE(p.read_end.read_some(io::buffer(buf), ec) == 1);
+
+    // Errors from an earlier call do not linger
+    ec = std::make_error_code(std::errc::io_error);
+    const std::array<io::const_buffer, 1> bufs{{io::buffer("y", 1)}};
+    REQUIRE(p.write_end.write_some(bufs, ec) == 1);
+    REQUIRE_FALSE(ec);
+}
+
+TEST_CASE("io::read and io::write wait on non-blocking streams", "[descriptor_stream]")
+{
+    pipe_pair p;
+    p.read_end.set_non_blocking(true);
+    p.write_end.set_non_blocking(true);
+
+    // Much larger than the capacity of a pipe
+    const std::string contents(1024 * 1024, 'x');
+    std::string received(contents.size(), '\0');
+    std::size_t bytes_read = 0;
+    std::error_code read_ec;
+
+    std::thread reader{[&] {
+        bytes_read = io::read(p.read_end, io::buffer(received), read_ec);
+    }};
+
+    std::error_code ec;
+    const auto bytes_written = io::write(p.write_end, io::buffer(contents), ec);
+    reader.join();
+
+    REQUIRE_FALSE(ec);
+    REQUIRE(bytes_written == contents.size());
+    REQUIRE_FALSE(read_ec);
+    REQUIRE(bytes_read == contents.size());
+    REQUIRE(received == contents);
+}
+
+#endif // __linux__
@@ -5,12 +5,29 @@
 
 #include "catch.hpp"
 
+#include <io/aligned_allocator.hpp>
+#include <io/buffered_read_stream.hpp>
+#include <io/buffered_write_stream.hpp>
 #include <io/file.hpp>
+#include <io/group_commit_writer.hpp>
 #include <io/read.hpp>
-//#include <io/posix/mmap_file.hpp>
+#include <io/read_at.hpp>
+#include <io/string_stream.hpp>
+#include <io/write_at.hpp>
 #include <io/io_std/string_view.hpp>
 
+#ifdef __linux__
+#include <io/posix/mapped_file_cache.hpp>
+#include <io/posix/mmap_file.hpp>
+#include <io/posix/mmap_window_file.hpp>
+#endif
+
+#include <array>
+#include <condition_variable>
 #include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 // FIXME: This entire file needs to be much, much better
 
@@ -79,4 +96,791 @@ TEST_CASE("File writes work as expected", "[file]")
         test_write(file);
         std::remove(test_file_name);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Positional reads and writes do not use the file cursor", "[file]")
+{
+    static_assert(io::is_random_access_read_stream_v<io::posix::file>, "");
+    static_assert(io::is_random_access_write_stream_v<io::posix::file>, "");
+
+    io::posix::file file{test_file_name, io::open_mode::read_write |
+                                         io::open_mode::always_create};
+
+    // Write the two halves out of order
+    const auto half = test_file_contents.size() / 2;
+    REQUIRE(io::write_at(file, half, io::buffer(test_file_contents.substr(half))) ==
+            test_file_contents.size() - half);
+    REQUIRE(io::write_at(file, 0, io::buffer(test_file_contents.substr(0, half))) ==
+            half);
+    REQUIRE(file.seek(0, io::seek_mode::current).offset_from_start() == 0);
+
+    // Read disjoint ranges concurrently through the same descriptor
+    std::string first(half, '\0');
+    std::string second(test_file_contents.size() - half, '\0');
+    std::error_code ec1, ec2;
+    std::thread t1{[&] { io::read_at(file, 0, io::buffer(first), ec1); }};
+    std::thread t2{[&] { io::read_at(file, half, io::buffer(second), ec2); }};
+    t1.join();
+    t2.join();
+
+    REQUIRE_FALSE(ec1);
+    REQUIRE_FALSE(ec2);
+    REQUIRE((first + second == test_file_contents));
+
+    std::string past_end(4, '\0');
+    std::error_code ec;
+    REQUIRE(io::read_at(file, test_file_contents.size() - 2, io::buffer(past_end), ec) == 2);
+    REQUIRE(ec == io::stream_errc::eof);
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("Direct I/O through aligned buffered streams", "[file]")
+{
+    using allocator_type = io::aligned_allocator<unsigned char>;
+
+    // Several blocks plus a partial one, to exercise the unaligned tail
+    std::string contents;
+    while (contents.size() < 3 * io::default_io_alignment) {
+        contents += std::string(test_file_contents);
+    }
+
+    std::error_code ec;
+    auto out = io::open_file(test_file_name, io::open_mode::write_only |
+                                             io::open_mode::always_create |
+                                             io::open_mode::direct, ec);
+    if (ec) {
+        // Not every filesystem supports O_DIRECT
+        WARN("Direct I/O is not available: " << ec.message());
+        std::remove(test_file_name);
+        return;
+    }
+
+    {
+        io::buffered_write_stream<io::file, allocator_type> stream{
+                std::move(out), io::default_io_alignment, allocator_type{}};
+        REQUIRE(io::write(stream, io::buffer(contents)) == contents.size());
+        REQUIRE_NOTHROW(stream.flush());
+    }
+
+    io::buffered_read_stream<io::file, allocator_type> stream{
+            io::open_file(test_file_name, io::open_mode::read_only |
+                                          io::open_mode::direct),
+            io::default_io_alignment, allocator_type{}};
+    std::string read_back;
+    REQUIRE_NOTHROW(io::read_all(stream, io::dynamic_buffer(read_back)));
+    REQUIRE(read_back == contents);
+
+    // Unaligned transfers go through a second descriptor, leaving the
+    // direct one (which other threads may be using) untouched
+    io::posix::file direct{test_file_name, io::open_mode::read_only |
+                                           io::open_mode::direct};
+    std::string tail(10, '\0');
+    REQUIRE(direct.read_some_at(contents.size() - 10, io::buffer(tail)) == 10);
+    REQUIRE(tail == contents.substr(contents.size() - 10));
+#ifdef O_DIRECT
+    REQUIRE((::fcntl(direct.native_handle(), F_GETFL) & O_DIRECT) != 0);
+#endif
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("Scatter/gather transfers are not limited in length", "[file]")
+{
+    // Interleave fragments so that no two buffers are contiguous, and use
+    // more fragments than fit in a single vectored system call
+    constexpr std::size_t num_fragments = 2500;
+    std::string source(2 * num_fragments, '-');
+    std::vector<io::const_buffer> gather;
+    std::string expected;
+    for (std::size_t i = 0; i < num_fragments; i++) {
+        source[2 * i] = static_cast<char>('a' + i % 26);
+        gather.push_back(io::buffer(&source[2 * i], 1));
+        expected += source[2 * i];
+    }
+
+    io::posix::file file{test_file_name, io::open_mode::read_write |
+                                         io::open_mode::always_create};
+    REQUIRE(file.write_some(gather) == num_fragments);
+
+    std::string dest(2 * num_fragments, '-');
+    std::vector<io::mutable_buffer> scatter;
+    for (std::size_t i = 0; i < num_fragments; i++) {
+        scatter.push_back(io::buffer(&dest[2 * i], 1));
+    }
+
+    file.seek(0, io::seek_mode::start);
+    REQUIRE(file.read_some(scatter) == num_fragments);
+    REQUIRE(dest == source);
+
+    // Contiguous fragments are merged, and should also round-trip
+    std::vector<io::mutable_buffer> contiguous;
+    std::string merged(num_fragments, '\0');
+    for (std::size_t i = 0; i < num_fragments; i++) {
+        contiguous.push_back(io::buffer(&merged[i], 1));
+    }
+    REQUIRE(file.read_some_at(0, contiguous) == num_fragments);
+    REQUIRE(merged == expected);
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("Access hints can be given for files", "[file]")
+{
+    std::string contents;
+    while (contents.size() < 2 * io::buffered_read_stream<io::file>::drop_behind_granularity) {
+        contents += std::string(test_file_contents);
+    }
+
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::always_create};
+        io::write(out, io::buffer(contents));
+    }
+
+    SECTION("posix::file") {
+        io::posix::file file{test_file_name, io::open_mode::read_only};
+        REQUIRE_NOTHROW(file.advise(0, 0, io::access_hint::sequential));
+        REQUIRE_NOTHROW(file.advise(0, 4096, io::access_hint::willneed));
+        REQUIRE_NOTHROW(file.advise(0, 0, io::access_hint::dontneed));
+    }
+
+#ifdef __linux__
+    SECTION("posix::mmap_file") {
+        io::posix::mmap_file file{test_file_name, io::open_mode::read_only};
+        REQUIRE_NOTHROW(file.advise(0, 0, io::access_hint::sequential));
+        REQUIRE_NOTHROW(file.advise(100, 10, io::access_hint::willneed));
+        REQUIRE_NOTHROW(file.advise(0, 0, io::access_hint::noreuse));
+    }
+#endif
+
+    SECTION("buffered_read_stream with drop-behind") {
+        io::buffered_read_stream<io::file> stream{
+                io::open_file(test_file_name, io::open_mode::read_only)};
+        stream.set_drop_behind(true);
+        REQUIRE(stream.drop_behind());
+
+        std::string read_back;
+        REQUIRE_NOTHROW(io::read_all(stream, io::dynamic_buffer(read_back)));
+        REQUIRE(read_back == contents);
+    }
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("Files can be preallocated and resized", "[file]")
+{
+    constexpr std::size_t expected_size = 1024 * 1024;
+
+    SECTION("posix::file") {
+        io::posix::file file{test_file_name, io::open_mode::read_write |
+                                             io::open_mode::always_create};
+        REQUIRE_NOTHROW(file.allocate(0, expected_size));
+        REQUIRE(file.seek(0, io::seek_mode::end).offset_from_start() == expected_size);
+        REQUIRE(file.seek(0, io::seek_mode::start).offset_from_start() == 0);
+
+        REQUIRE_NOTHROW(file.resize(test_file_contents.size()));
+        REQUIRE(file.seek(0, io::seek_mode::end).offset_from_start() ==
+                test_file_contents.size());
+    }
+
+    SECTION("buffered_write_stream trims unused space on close") {
+        io::buffered_write_stream<io::file> stream{
+                io::open_file(test_file_name, io::open_mode::write_only |
+                                              io::open_mode::always_create)};
+        REQUIRE_NOTHROW(stream.preallocate(expected_size));
+        REQUIRE(stream.next_layer().seek(0, io::seek_mode::end).offset_from_start() ==
+                expected_size);
+        stream.next_layer().seek(0, io::seek_mode::start);
+
+        REQUIRE_NOTHROW(io::write(stream, io::buffer(test_file_contents)));
+        REQUIRE_NOTHROW(stream.close());
+
+        io::file file{test_file_name, io::open_mode::read_only};
+        test_read(file);
+    }
+
+    SECTION("buffered_write_stream trims unused space on destruction") {
+        {
+            io::buffered_write_stream<io::file> stream{
+                    io::open_file(test_file_name, io::open_mode::write_only |
+                                                  io::open_mode::always_create)};
+            stream.preallocate(expected_size);
+            io::write(stream, io::buffer(test_file_contents));
+        }
+
+        io::file file{test_file_name, io::open_mode::read_only};
+        test_read(file);
+    }
+
+    SECTION("buffered_write_stream does not preallocate in append mode") {
+        const auto head = test_file_contents.substr(0, 5);
+        const auto tail = test_file_contents.substr(5);
+        {
+            io::file file{test_file_name, io::open_mode::write_only |
+                                          io::open_mode::always_create};
+            io::write(file, io::buffer(head));
+        }
+
+        io::buffered_write_stream<io::file> stream{
+                io::open_file(test_file_name, io::open_mode::write_only |
+                                              io::open_mode::append)};
+        REQUIRE_NOTHROW(stream.preallocate(expected_size));
+        REQUIRE_NOTHROW(io::write(stream, io::buffer(tail)));
+        REQUIRE_NOTHROW(stream.close());
+
+        io::file file{test_file_name, io::open_mode::read_only};
+        test_read(file);
+    }
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("Files can be flushed in part", "[file]")
+{
+    io::posix::file file{test_file_name, io::open_mode::write_only |
+                                         io::open_mode::always_create};
+    io::write(file, io::buffer(test_file_contents));
+
+    REQUIRE_NOTHROW(file.sync_range(0, 0, io::sync_range_flags::write));
+    REQUIRE_NOTHROW(file.sync_range(0, 10, io::sync_range_flags::wait_before |
+                                           io::sync_range_flags::write |
+                                           io::sync_range_flags::wait_after));
+    REQUIRE_NOTHROW(file.sync_data());
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("group_commit_writer makes writes from many threads durable", "[file]")
+{
+    constexpr int num_threads = 8;
+    constexpr int commits_per_thread = 25;
+
+    {
+        io::group_commit_writer<io::file> writer{
+                io::open_file(test_file_name, io::open_mode::write_only |
+                                              io::open_mode::always_create)};
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < num_threads; i++) {
+            threads.emplace_back([&writer] {
+                for (int j = 0; j < commits_per_thread; j++) {
+                    writer.commit(writer.write(io::buffer(test_file_contents)));
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        REQUIRE(writer.sync_count() > 0);
+    }
+
+    std::string contents;
+    {
+        io::file file{test_file_name, io::open_mode::read_only};
+        io::read_all(file, io::dynamic_buffer(contents));
+    }
+    REQUIRE(contents.size() ==
+            num_threads * commits_per_thread * test_file_contents.size());
+
+    std::remove(test_file_name);
+}
+
+namespace {
+
+// A string_stream whose sync_data() blocks until it is released, so that
+// commits can be made to queue up behind a flush
+struct gated_sync_stream : io::string_stream {
+    void sync_data(std::error_code& ec)
+    {
+        ec.clear();
+        std::unique_lock<std::mutex> lock{mutex};
+        ++sync_calls;
+        cond.notify_all();
+        cond.wait(lock, [this] { return released; });
+    }
+
+    void wait_for_sync()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        cond.wait(lock, [this] { return sync_calls > 0; });
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        released = true;
+        cond.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    int sync_calls = 0;
+    bool released = false;
+};
+
+}
+
+TEST_CASE("group_commit_writer flushes waiting commits together", "[file]")
+{
+    constexpr int num_waiters = 8;
+
+    gated_sync_stream stream;
+    io::group_commit_writer<gated_sync_stream&> writer{stream};
+
+    // The first commit leads a flush, which is held up
+    std::thread leader{[&writer] {
+        writer.commit(writer.write(io::buffer(test_file_contents)));
+    }};
+    stream.wait_for_sync();
+
+    // Everything written while it is running must wait for the next flush
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_waiters; i++) {
+        const auto ticket = writer.write(io::buffer(test_file_contents));
+        threads.emplace_back([&writer, ticket] {
+            writer.commit(ticket);
+        });
+    }
+
+    stream.release();
+    leader.join();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // ...and one flush covers them all
+    REQUIRE(writer.sync_count() == 2);
+    REQUIRE(stream.str().size() == (num_waiters + 1) * test_file_contents.size());
+}
+
+#ifdef __linux__
+
+TEST_CASE("Writable mmap_files grow as they are written", "[file]")
+{
+    std::string contents;
+    while (contents.size() < 3 * io::posix::mmap_file::min_growth) {
+        contents += std::string(test_file_contents);
+    }
+
+    {
+        io::posix::mmap_file file{test_file_name, io::open_mode::write_only |
+                                                  io::open_mode::always_create};
+        REQUIRE(file.size() == 0);
+
+        std::size_t bytes_written = 0;
+        while (bytes_written < contents.size()) {
+            bytes_written += io::write(file, io::buffer(test_file_contents));
+        }
+        REQUIRE(bytes_written == contents.size());
+        REQUIRE(file.size() == static_cast<io::posix::mmap_file::size_type>(contents.size()));
+        REQUIRE(file.capacity() >= file.size());
+
+        // Overwriting existing data does not change the size
+        file.seek(0, io::seek_mode::start);
+        io::write(file, io::buffer("THE", 3));
+        contents.replace(0, 3, "THE");
+        REQUIRE(file.size() == static_cast<io::posix::mmap_file::size_type>(contents.size()));
+
+        REQUIRE_NOTHROW(file.close());
+    }
+
+    std::string read_back;
+    {
+        io::file file{test_file_name, io::open_mode::read_only};
+        io::read_all(file, io::dynamic_buffer(read_back));
+    }
+    REQUIRE(read_back == contents);
+
+    SECTION("Read-only mappings cannot be written") {
+        io::posix::mmap_file file{test_file_name, io::open_mode::read_only};
+        std::error_code ec;
+        REQUIRE(file.write_some(io::buffer("x", 1), ec) == 0);
+        REQUIRE(ec);
+    }
+
+    SECTION("Files which were not extended are left alone") {
+        // Backdate the file, so that any change to it is visible
+        const struct ::timespec times[2] = {{1577836800, 0}, {1577836800, 0}};
+        REQUIRE(::utimensat(AT_FDCWD, test_file_name, times, 0) == 0);
+
+        io::posix::mmap_file file{test_file_name, io::open_mode::read_write};
+        REQUIRE_NOTHROW(file.close());
+
+        struct ::stat st;
+        REQUIRE(::stat(test_file_name, &st) == 0);
+        REQUIRE(st.st_mtime == 1577836800);
+
+        // Nor is data appended by another writer cut off
+        file.open(test_file_name, io::open_mode::read_write);
+        {
+            io::file out{test_file_name, io::open_mode::write_only |
+                                         io::open_mode::append};
+            io::write(out, io::buffer("!", 1));
+        }
+        REQUIRE_NOTHROW(file.close());
+
+        REQUIRE(::stat(test_file_name, &st) == 0);
+        REQUIRE(st.st_size == static_cast<::off_t>(contents.size() + 1));
+    }
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("mmap_window_file maps a window around the cursor", "[file]")
+{
+    const auto page_size = ::sysconf(_SC_PAGESIZE);
+    std::string contents;
+    while (contents.size() < static_cast<std::size_t>(3 * page_size + 100)) {
+        contents += std::string(test_file_contents);
+    }
+
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::always_create};
+        io::write(out, io::buffer(contents));
+    }
+
+    io::posix::mmap_window_file file{test_file_name, page_size};
+    REQUIRE(file.size() == static_cast<off_t>(contents.size()));
+    REQUIRE(file.window_size() == page_size);
+
+    SECTION("Reading as a stream") {
+        std::string read_back;
+        REQUIRE_NOTHROW(io::read_all(file, io::dynamic_buffer(read_back)));
+        REQUIRE(read_back == contents);
+    }
+
+    SECTION("Iterating over windows") {
+        std::string read_back;
+        std::error_code ec;
+        REQUIRE(file.map_window(ec));
+        do {
+            REQUIRE(file.window_offset() == static_cast<off_t>(read_back.size()));
+            read_back.append(file.begin(), file.end());
+        } while (file.next_window());
+        REQUIRE(read_back == contents);
+    }
+
+    SECTION("Seeking remaps the window") {
+        file.seek(2 * page_size + 5, io::seek_mode::start);
+        REQUIRE(file.read_next() == static_cast<unsigned char>(contents[2 * page_size + 5]));
+        REQUIRE(file.window_offset() == 2 * page_size);
+
+        file.seek(-10, io::seek_mode::end);
+        REQUIRE(file.peek_next() == static_cast<unsigned char>(contents[contents.size() - 10]));
+        REQUIRE(file.window_offset() == 3 * page_size);
+    }
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("mmap_files can be mapped with options", "[file]")
+{
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::always_create};
+        io::write(out, io::buffer(test_file_contents));
+    }
+
+    io::posix::mmap_options options;
+    options.populate = true;
+    options.huge_pages = true;
+    options.hint = io::access_hint::sequential;
+
+    SECTION("Pre-populated huge page mapping") {
+        io::posix::mmap_file file{test_file_name, io::open_mode::read_only,
+                                  io::default_creation_perms, options};
+        test_read(file);
+    }
+
+    SECTION("Locked mapping") {
+        options.lock = true;
+        io::posix::mmap_file file;
+        std::error_code ec;
+        file.open(test_file_name, io::open_mode::read_only,
+                  io::default_creation_perms, options, ec);
+        if (ec == std::errc::operation_not_permitted ||
+            ec == std::errc::not_enough_memory) {
+            WARN("Cannot lock memory: " << ec.message());
+        } else {
+            REQUIRE_FALSE(ec);
+            test_read(file);
+        }
+    }
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("mmap_files can prefetch ahead of sequential reads", "[file]")
+{
+    std::string contents;
+    while (contents.size() < 100 * 1024) {
+        contents += std::string(test_file_contents);
+    }
+
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::always_create};
+        io::write(out, io::buffer(contents));
+    }
+
+    io::posix::mmap_file file{test_file_name, io::open_mode::read_only};
+
+    SECTION("Read-ahead from read_some() and read_next()") {
+        file.set_read_ahead(16 * 1024);
+        REQUIRE(file.read_ahead() == 16 * 1024);
+
+        std::string read_back;
+        read_back += static_cast<char>(file.read_next());
+        REQUIRE_NOTHROW(io::read_all(file, io::dynamic_buffer(read_back)));
+        REQUIRE(read_back == contents);
+    }
+
+    SECTION("Chunked iteration") {
+        std::string read_back;
+        std::size_t num_chunks = 0;
+        for (auto chunk : file.chunks(4096, 16 * 1024)) {
+            REQUIRE(chunk.size() <= 4096);
+            read_back.append(static_cast<const char*>(chunk.data()), chunk.size());
+            ++num_chunks;
+        }
+        REQUIRE(num_chunks == (contents.size() + 4095) / 4096);
+        REQUIRE(read_back == contents);
+
+        // Zero-sized chunks would never get anywhere
+        REQUIRE_THROWS(file.chunks(0));
+    }
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("mapped_file_cache shares mappings between opens", "[file]")
+{
+    constexpr char other_file_name[] = "io_test_file_2.txt";
+    const std::string big_contents(600 * 1024, 'x');
+
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::create |
+                                            io::open_mode::truncate};
+        io::write(out, io::buffer(test_file_contents));
+    }
+
+    io::posix::mapped_file_cache cache{1024 * 1024};
+
+    auto view1 = cache.open(test_file_name);
+    auto view2 = cache.open(test_file_name);
+    REQUIRE(view1.data() == view2.data());
+    REQUIRE(cache.size() == 1);
+    test_read(view1);
+    test_read(view2);
+
+    SECTION("Modified files are mapped again") {
+        {
+            io::posix::file out{test_file_name, io::open_mode::write_only |
+                                                io::open_mode::append};
+            io::write(out, io::buffer("!", 1));
+        }
+        auto view3 = cache.open(test_file_name);
+        REQUIRE(view3.size() == view1.size() + 1);
+        REQUIRE(cache.size() == 2);
+    }
+
+    SECTION("Least recently used mappings are evicted over budget") {
+        {
+            io::posix::file out{other_file_name, io::open_mode::write_only |
+                                                 io::open_mode::create |
+                                                 io::open_mode::truncate};
+            io::write(out, io::buffer(big_contents));
+        }
+        auto big_view = cache.open(other_file_name);
+        REQUIRE(cache.size() == 2);
+
+        // Make the big file the least recently used
+        cache.open(test_file_name);
+
+        std::remove(other_file_name);
+        {
+            io::posix::file out{other_file_name, io::open_mode::write_only |
+                                                 io::open_mode::create};
+            io::write(out, io::buffer(big_contents + "y"));
+        }
+        cache.open(other_file_name);
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.mapped_bytes() <= cache.budget());
+        REQUIRE(cache.open(test_file_name).data() == view1.data());
+
+        // The evicted mapping is still usable
+        REQUIRE(big_view.size() == static_cast<::off_t>(big_contents.size()));
+        std::string str(big_contents.size(), '\0');
+        io::read(big_view, io::buffer(str));
+        REQUIRE(str == big_contents);
+        std::remove(other_file_name);
+    }
+
+    SECTION("Concurrent opens") {
+        cache.clear();
+        std::vector<std::thread> threads;
+        std::vector<const void*> addresses(8);
+        for (std::size_t i = 0; i < addresses.size(); i++) {
+            threads.emplace_back([&, i] {
+                addresses[i] = cache.open(test_file_name).data();
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        REQUIRE(cache.size() == 1);
+        for (auto addr : addresses) {
+            REQUIRE(addr != nullptr);
+        }
+    }
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("mmap_files can be flushed in part", "[file]")
+{
+    const std::string contents(256 * 1024, 'a');
+    const auto page_size = ::sysconf(_SC_PAGESIZE);
+
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::create |
+                                            io::open_mode::truncate};
+        io::write(out, io::buffer(contents));
+    }
+
+    io::posix::mmap_file f{test_file_name, io::open_mode::read_write};
+
+    SECTION("Explicit ranges") {
+        f.seek(1000, io::seek_mode::start);
+        io::write(f, io::buffer("patch", 5));
+        f.flush(1000, 5);
+        f.flush(0, 0, true);
+        REQUIRE_THROWS(f.flush(-1, 5));
+    }
+
+    SECTION("Dirty tracking") {
+        f.set_dirty_tracking(true);
+        REQUIRE(f.dirty_size() == 0);
+
+        f.seek(10, io::seek_mode::start);
+        io::write(f, io::buffer("xy", 2));
+        f.seek(3 * page_size - 1, io::seek_mode::start);
+        io::write(f, io::buffer("xy", 2));
+        f.seek(20, io::seek_mode::start);
+        io::write(f, io::buffer("z", 1));
+        REQUIRE(f.dirty_size() == 3 * page_size);
+
+        f.flush();
+        REQUIRE(f.dirty_size() == 0);
+
+        // Writes past the end are tracked too
+        f.seek(0, io::seek_mode::end);
+        io::write(f, io::buffer("tail", 4));
+        REQUIRE(f.dirty_size() > 0);
+        f.flush();
+        REQUIRE(f.dirty_size() == 0);
+    }
+
+    f.close();
+
+    std::string str;
+    io::posix::file in{test_file_name, io::open_mode::read_only};
+    io::read_all(in, io::dynamic_buffer(str));
+    REQUIRE(str.size() >= contents.size());
+    REQUIRE(str.compare(0, 10, contents, 0, 10) == 0);
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("Copy-on-write mmap_files can be patched privately", "[file]")
+{
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::create |
+                                            io::open_mode::truncate};
+        io::write(out, io::buffer(test_file_contents));
+    }
+
+    io::posix::mmap_options options;
+    options.copy_on_write = true;
+
+    io::posix::mmap_file snapshot{test_file_name, io::open_mode::read_only,
+                                  io::default_creation_perms, options};
+    io::posix::mmap_file other{test_file_name, io::open_mode::read_only,
+                               io::default_creation_perms, options};
+
+    snapshot.seek(4, io::seek_mode::start);
+    io::write(snapshot, io::buffer("QUICK", 5));
+
+    const auto as_string = [] (const io::posix::mmap_file& f) {
+        return std::string(static_cast<const char*>(f.data()), f.size());
+    };
+
+    REQUIRE(as_string(snapshot) == "The QUICK brown fox jumps over the lazy dog");
+    REQUIRE(as_string(other) == test_file_contents);
+
+    // Advice never discards the patched pages
+    REQUIRE_NOTHROW(snapshot.advise(0, 0, io::access_hint::dontneed));
+    REQUIRE(as_string(snapshot) == "The QUICK brown fox jumps over the lazy dog");
+
+    // Flushing does not write the changes back
+    REQUIRE_NOTHROW(snapshot.flush());
+    snapshot.close();
+
+    std::string str;
+    {
+        io::posix::file in{test_file_name, io::open_mode::read_only};
+        io::read_all(in, io::dynamic_buffer(str));
+    }
+    REQUIRE(str == test_file_contents);
+
+    SECTION("Snapshots do not grow") {
+        other.seek(-3, io::seek_mode::end);
+        std::error_code ec;
+        REQUIRE(other.write_some(io::buffer("DOGS", 4), ec) == 3);
+        REQUIRE_FALSE(ec);
+        REQUIRE(other.write_some(io::buffer("S", 1), ec) == 0);
+        REQUIRE(ec == std::errc::file_too_large);
+        REQUIRE(other.size() == static_cast<io::posix::mmap_file::size_type>(
+                test_file_contents.size()));
+    }
+
+    std::remove(test_file_name);
+}
+
+#endif // __linux__
+
+TEST_CASE("Adaptive buffered file reads grow in whole blocks", "[file]")
+{
+    const std::string contents(1024 * 1024, 'x');
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::create |
+                                            io::open_mode::truncate};
+        io::write(out, io::buffer(contents));
+    }
+
+    struct ::stat st;
+    REQUIRE(::stat(test_file_name, &st) == 0);
+    const auto block_size = static_cast<std::size_t>(st.st_blksize);
+
+    io::buffered_read_stream<io::posix::file> stream{
+            io::posix::file{test_file_name, io::open_mode::read_only}, 100};
+    stream.set_adaptive(64 * block_size);
+
+    // Small reads, which are served from the buffer
+    std::string str;
+    std::array<char, 64> buf;
+    while (str.size() < contents.size()) {
+        str.append(buf.data(), io::read(stream, io::buffer(buf)));
+    }
+    REQUIRE(str == contents);
+    REQUIRE(stream.buffer_capacity() > 100);
+    REQUIRE(stream.buffer_capacity() % block_size == 0);
+
+    std::remove(test_file_name);
+}
@@ -5,6 +5,7 @@
 
 #include "catch.hpp"
 
+#include <io/buffered_read_stream.hpp>
 #include <io/string_stream.hpp>
 #include <io/read.hpp>
 
@@ -53,7 +54,7 @@ TEST_CASE("io::read_until finds a substring in a string", "[read][read_until]")
     std::size_t bytes_read;
 
     REQUIRE_NOTHROW(bytes_read = io::read_until(d, io::dynamic_buffer(buf), "ef", ec));
-    REQUIRE(bytes_read == 5);
+    REQUIRE(bytes_read == 6);
     REQUIRE_FALSE(ec);
 }
 
@@ -64,7 +65,7 @@ TEST_CASE("io::read_until finds a substring in a string (throwing)", "[read][rea
     std::size_t bytes_read = 0;
 
     REQUIRE_NOTHROW(bytes_read = io::read_until(d, io::dynamic_buffer(buf), "ef"));
-    REQUIRE(bytes_read == 5);
+    REQUIRE(bytes_read == 6);
 }
 
 TEST_CASE("io::read_until correctly reports a missing substring", "[read][read_until]")
@@ -78,4 +79,41 @@ TEST_CASE("io::read_until correctly reports a missing substring", "[read][read_u
     REQUIRE(bytes_read == test_string.size());
     REQUIRE(ec.category() == io::stream_category());
     REQUIRE(ec == io::stream_errc::not_found);
-}
\ No newline at end of file
+}
+TEST_CASE("io::read_until counts buffered and unbuffered reads alike", "[read][read_until]")
+{
+    std::vector<char> buf;
+    io::buffered_read_stream<io::string_stream> d{io::string_stream{test_string}, 8};
+    std::error_code ec;
+    std::size_t bytes_read = 0;
+
+    REQUIRE_NOTHROW(bytes_read = io::read_until(d, io::dynamic_buffer(buf), "ef", ec));
+    REQUIRE(bytes_read == 6);
+    REQUIRE_FALSE(ec);
+}
+
+TEST_CASE("io::read_until finds a delimiter longer than the stream buffer", "[read][read_until]")
+{
+    const std::string str = "abcdefghij0123456789klmnop";
+    std::vector<char> buf;
+    io::buffered_read_stream<io::string_stream> d{io::string_stream{str}, 8};
+    std::error_code ec;
+    std::size_t bytes_read = 0;
+
+    REQUIRE_NOTHROW(bytes_read = io::read_until(d, io::dynamic_buffer(buf), "0123456789", ec));
+    REQUIRE_FALSE(ec);
+    REQUIRE(bytes_read == 20);
+    REQUIRE(std::string(buf.begin(), buf.begin() + bytes_read) == str.substr(0, 20));
+}
+
+TEST_CASE("io::read_until reports a missing delimiter longer than the stream buffer", "[read][read_until]")
+{
+    std::vector<char> buf;
+    io::buffered_read_stream<io::string_stream> d{io::string_stream{test_string}, 8};
+    std::error_code ec;
+    std::size_t bytes_read = 0;
+
+    REQUIRE_NOTHROW(bytes_read = io::read_until(d, io::dynamic_buffer(buf), "0123456789", ec));
+    REQUIRE(bytes_read == test_string.size());
+    REQUIRE(ec == io::stream_errc::not_found);
+}
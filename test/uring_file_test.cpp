@@ -0,0 +1,144 @@
+// Copyright (c) 2017 Tristan Brindle (tcbrindle at gmail dot com)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifdef __linux__
+
+#include "catch.hpp"
+
+#include <io/posix/uring_file.hpp>
+#include <io/read.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr char test_file_name[] = "io_uring_test_file.txt";
+
+const std::string test_file_contents =
+    "The quick brown fox jumps over the lazy dog";
+
+}
+
+TEST_CASE("uring_file can write and read back as a stream", "[file][uring]")
+{
+    std::error_code ec;
+    io::posix::uring ring{8, ec};
+    if (ec) {
+        WARN("io_uring is not available: " << ec.message());
+        return;
+    }
+
+    {
+        io::posix::uring_file file{ring, test_file_name,
+                                   io::open_mode::write_only |
+                                   io::open_mode::create |
+                                   io::open_mode::truncate};
+        REQUIRE(io::write(file, io::buffer(test_file_contents)) ==
+                test_file_contents.size());
+    }
+
+    io::posix::uring_file file{ring, test_file_name, io::open_mode::read_only};
+    std::string contents;
+    REQUIRE_NOTHROW(io::read_all(file, io::dynamic_buffer(contents)));
+    REQUIRE(contents == test_file_contents);
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("uring_file batched reads return every range", "[file][uring]")
+{
+    std::error_code ec;
+    // Deliberately smaller than the number of requests, to force several
+    // submissions
+    io::posix::uring ring{4, ec};
+    if (ec) {
+        WARN("io_uring is not available: " << ec.message());
+        return;
+    }
+
+    {
+        io::posix::file out{test_file_name, io::open_mode::write_only |
+                                            io::open_mode::create |
+                                            io::open_mode::truncate};
+        io::write(out, io::buffer(test_file_contents));
+    }
+
+    io::posix::uring_file file{ring, test_file_name, io::open_mode::read_only};
+
+    constexpr std::size_t chunk_size = 4;
+    const std::size_t num_chunks = test_file_contents.size() / chunk_size + 1;
+    std::vector<std::string> chunks(num_chunks, std::string(chunk_size, '\0'));
+    std::vector<io::posix::uring_read_request> requests(num_chunks);
+
+    for (std::size_t i = 0; i < num_chunks; i++) {
+        requests[i].offset = i * chunk_size;
+        requests[i].buffer = io::buffer(chunks[i]);
+    }
+
+    std::size_t bytes_read = 0;
+    REQUIRE_NOTHROW(bytes_read = file.read_batch(requests.begin(), requests.end(), ec));
+    REQUIRE_FALSE(ec);
+    REQUIRE(bytes_read == test_file_contents.size());
+    REQUIRE(ring.in_flight() == 0);
+
+    std::string contents;
+    for (std::size_t i = 0; i < num_chunks; i++) {
+        REQUIRE_FALSE(requests[i].error);
+        contents += chunks[i].substr(0, requests[i].bytes_transferred);
+    }
+    REQUIRE(contents == test_file_contents);
+
+    std::remove(test_file_name);
+}
+
+TEST_CASE("uring_file batched writes fill every range", "[file][uring]")
+{
+    std::error_code ec;
+    io::posix::uring ring{4, ec};
+    if (ec) {
+        WARN("io_uring is not available: " << ec.message());
+        return;
+    }
+
+    io::posix::uring_file file{ring, test_file_name,
+                               io::open_mode::read_write |
+                               io::open_mode::create |
+                               io::open_mode::truncate};
+
+    // Write the chunks in reverse order, so that each lands at its offset
+    // rather than at the cursor
+    constexpr std::size_t chunk_size = 4;
+    const std::size_t num_chunks = (test_file_contents.size() + chunk_size - 1) / chunk_size;
+    std::vector<io::posix::uring_write_request> requests(num_chunks);
+
+    for (std::size_t i = 0; i < num_chunks; i++) {
+        const std::size_t offset = (num_chunks - 1 - i) * chunk_size;
+        requests[i].offset = offset;
+        requests[i].buffer = io::buffer(test_file_contents.data() + offset,
+                std::min(chunk_size, test_file_contents.size() - offset));
+    }
+
+    std::size_t bytes_written = 0;
+    REQUIRE_NOTHROW(bytes_written = file.write_batch(requests.begin(), requests.end(), ec));
+    REQUIRE_FALSE(ec);
+    REQUIRE(bytes_written == test_file_contents.size());
+    REQUIRE(ring.in_flight() == 0);
+    for (const auto& request : requests) {
+        REQUIRE_FALSE(request.error);
+        REQUIRE(request.bytes_transferred == request.buffer.size());
+    }
+
+    // The cursor has not moved
+    REQUIRE(file.seek(0, io::seek_mode::current).offset_from_start() == 0);
+
+    std::string contents;
+    io::read_all(file, io::dynamic_buffer(contents));
+    REQUIRE(contents == test_file_contents);
+
+    std::remove(test_file_name);
+}
+
+#endif // __linux__